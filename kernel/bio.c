@@ -19,6 +19,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
@@ -38,7 +39,7 @@ binit(void)
 {
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  initlocktype(&bcache.lock, "bcache", SPIN_MCS);
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
@@ -61,6 +62,7 @@ bget(uint dev, uint blockno)
   struct buf *b;
 
   acquire(&bcache.lock);
+  mycpu()->nbread++;
 
   // Is the block already cached?
   for(b = bcache.head.next; b != &bcache.head; b = b->next){
@@ -88,6 +90,23 @@ bget(uint dev, uint blockno)
   panic("bget: no buffers");
 }
 
+// Read or write b on the device it belongs to.
+static void
+devrw(struct buf *b, int write)
+{
+  push_off();
+  if(write)
+    mycpu()->ndiskwrite++;
+  else
+    mycpu()->ndiskread++;
+  pop_off();
+
+  if(b->dev == RAMDEV)
+    ramdiskrw(b, write);
+  else
+    striperw(b, write);
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf*
 bread(uint dev, uint blockno)
@@ -96,19 +115,33 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    devrw(b, 0);
     b->valid = 1;
   }
   return b;
 }
 
+// Return a locked buf of zeroes for the indicated block,
+// without reading it: for a newly allocated block that the
+// caller will write.
+struct buf*
+bzeroed(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  memset(b->data, 0, BSIZE);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  devrw(b, 1);
 }
 
 // Release a locked buffer.
@@ -2,8 +2,12 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kstat;
+struct meminfo;
 struct pipe;
 struct proc;
+struct procmem;
+struct rcu_head;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -12,6 +16,7 @@ struct superblock;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bzeroed(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
@@ -23,7 +28,7 @@ void            consoleintr(int);
 void            consputc(int);
 
 // exec.c
-int             exec(char*, char**);
+int             exec(char*, char**, int);
 
 // file.c
 struct file*    filealloc(void);
@@ -33,6 +38,8 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             fileseek(struct file*, int, int);
+int             filesync(struct file*);
 
 // fs.c
 void            fsinit(int);
@@ -51,13 +58,22 @@ struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
+int             iseekhole(struct inode*, uint, int);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
+void            itruncdefer(struct inode*);
+int             iclone(struct inode*, struct inode*);
+int             icompress(struct inode*);
+int             fsmount(struct inode*, uint);
+int             imounted(struct inode*);
+
+// lz.c
+int             lzcompress(uchar*, int, uchar*, int, void*);
+int             lzdecompress(uchar*, int, uchar*, int);
 
 // ramdisk.c
 void            ramdiskinit(void);
-void            ramdiskintr(void);
-void            ramdiskrw(struct buf*);
+void            ramdiskrw(struct buf*, int);
 
 // kalloc.c
 void*           kalloc(void);
@@ -65,12 +81,26 @@ void            kfree(void *);
 void            kinit(void);
 int             get_page_ref(uint64);
 int             inc_page_ref(uint64);
+void            kallocstat(struct kstat*);
+void            kallocinfo(struct meminfo*);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+int             log_direct(uint);
+void            log_free(uint);
+void            log_sync(void);
+int             log_datamode(int);
+
+// numa.c
+extern uint64   phystop;
+void            numainit(void);
+int             numanodes(void);
+int             cpunode(int);
+int             pa2node(uint64);
+int             memrangeget(int, uint64*, uint64*);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
@@ -87,10 +117,14 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             kthread(char*, void (*)(void));
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+int             rcubench(int, int);
+int             procmem(int, struct procmem*);
+struct proc*    pidlookup(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
@@ -115,10 +149,27 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlocktype(struct spinlock*, char*, int);
+int             lockbench(int, int);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// rcu.c
+void            rcuinit(void);
+void            rcu_read_lock(void);
+void            rcu_read_unlock(void);
+void            call_rcu(struct rcu_head*, void (*)(struct rcu_head*));
+void            rcu_quiescent(void);
+
+// trace.c
+void            traceinit(void);
+uint64          tracesyscall(int, uint64 (*)(void));
+int             traceattach(int, int);
+void            tracefork(struct proc*);
+void            traceexit(void);
+int             tracedump(uint64, int);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
@@ -159,6 +210,7 @@ void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
+uint64          vmptpages(void);
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
@@ -170,7 +222,9 @@ uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
-void            uvmclear(pagetable_t, uint64);
+int             uvmprefault(pagetable_t, uint64, uint64);
+int             uvmprotect(pagetable_t, uint64, uint64, int);
+void            uvmstat(pagetable_t, uint64, struct procmem*);
 pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
@@ -182,11 +236,19 @@ void            plicinit(void);
 void            plicinithart(void);
 int             plic_claim(void);
 void            plic_complete(int);
+void            plic_steer(int);
+int             plic_setaffinity(int, uint32);
+int             plic_stat(int, uint64*);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
-void            virtio_disk_intr(void);
+int             virtio_disk_count(void);
+void            virtio_disk_rw(int, struct buf *, uint, int);
+void            virtio_disk_intr(int);
+
+// stripe.c
+void            stripeinit(void);
+void            striperw(struct buf *, int);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
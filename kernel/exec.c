@@ -19,12 +19,16 @@ int flags2perm(int flags)
     return perm;
 }
 
+// argpages holds len bytes of arguments, packed by sys_exec()
+// into the layout they will have on the user stack: an argv[]
+// array of offsets from the start of the buffer, terminated by
+// 0, followed by the strings.
 int
-exec(char *path, char **argv)
+exec(char *path, char **argpages, int len)
 {
   char *s, *last;
-  int i, off;
-  uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
+  int i, off, n, npages;
+  uint64 argc, sz = 0, sp, *argv, stackbot, imgend;
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
@@ -75,39 +79,34 @@ exec(char *path, char **argv)
   p = myproc();
   uint64 oldsz = p->sz;
 
-  // Allocate two pages at the next page boundary.
-  // Make the first inaccessible as a stack guard.
-  // Use the second as the user stack.
+  // At the next page boundary, reserve USTACKSIZE bytes of
+  // address space for the stack, and allocate just enough
+  // pages at its top to hold the arguments. The arguments go
+  // at the top of the stack, and the program's stack grows
+  // down from just below them, a page fault at a time. The
+  // bottom page of the reservation is never mapped; it guards
+  // the program's data from a stack that outgrows the rest.
+  imgend = sz;
   sz = PGROUNDUP(sz);
-  uint64 sz1;
-  if((sz1 = uvmalloc(pagetable, sz, sz + 2*PGSIZE, PTE_W)) == 0)
+  stackbot = sz;
+  sz += USTACKSIZE;
+  npages = PGROUNDUP(len + 15) / PGSIZE;
+  if(uvmalloc(pagetable, sz - npages*PGSIZE, sz, PTE_W) == 0)
     goto bad;
-  sz = sz1;
-  uvmclear(pagetable, sz-2*PGSIZE);
-  sp = sz;
-  stackbase = sp - PGSIZE;
-
-  // Push argument strings, prepare rest of stack in ustack.
-  for(argc = 0; argv[argc]; argc++) {
-    if(argc >= MAXARG)
+  sp = sz - len;
+  sp -= sp % 16; // riscv sp must be 16-byte aligned
+
+  // turn the argv[] offsets into user addresses.
+  argv = (uint64*)argpages[0];
+  for(argc = 0; argv[argc]; argc++)
+    argv[argc] += sp;
+
+  // copy the arguments to the stack, a page of the buffer at a time.
+  for(i = 0; i*PGSIZE < len; i++){
+    n = len - i*PGSIZE < PGSIZE ? len - i*PGSIZE : PGSIZE;
+    if(copyout(pagetable, sp + i*PGSIZE, argpages[i], n) < 0)
       goto bad;
-    sp -= strlen(argv[argc]) + 1;
-    sp -= sp % 16; // riscv sp must be 16-byte aligned
-    if(sp < stackbase)
-      goto bad;
-    if(copyout(pagetable, sp, argv[argc], strlen(argv[argc]) + 1) < 0)
-      goto bad;
-    ustack[argc] = sp;
   }
-  ustack[argc] = 0;
-
-  // push the array of argv[] pointers.
-  sp -= (argc+1) * sizeof(uint64);
-  sp -= sp % 16;
-  if(sp < stackbase)
-    goto bad;
-  if(copyout(pagetable, sp, (char *)ustack, (argc+1)*sizeof(uint64)) < 0)
-    goto bad;
 
   // arguments to user main(argc, argv)
   // argc is returned via the system call return
@@ -121,9 +120,19 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  // p->lock keeps procmem() off the old page table.
+  acquire(&p->lock);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
+  p->imgend = imgend;
+  p->stackbot = stackbot;
+  p->stacktop = sz;
+  p->stacklow = sz - npages*PGSIZE;
+  release(&p->lock);
+  p->seqstart = p->seqend = 0;
+  p->segvhandler = 0;
+  p->insegv = 0;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
@@ -3,3 +3,15 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+#define O_SYNCCLOSE 0x800  // fsync() on the last close
+#define O_COMPRESS  0x1000 // compress the data of an empty file
+
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+#define SEEK_DATA 3  // next data at or after the offset
+#define SEEK_HOLE 4  // next hole at or after the offset
+
+// datamode()
+#define DATA_JOURNAL 0  // file data is written through the log
+#define DATA_ORDERED 1  // file data is written in place before the commit
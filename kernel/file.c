@@ -12,6 +12,7 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -71,6 +72,7 @@ fileclose(struct file *f)
   ff = *f;
   f->ref = 0;
   f->type = FD_NONE;
+  f->synconclose = 0;
   release(&ftable.lock);
 
   if(ff.type == FD_PIPE){
@@ -79,9 +81,24 @@ fileclose(struct file *f)
     begin_op();
     iput(ff.ip);
     end_op();
+    if(ff.synconclose)
+      log_sync();
   }
 }
 
+// Wait until what was written to file f is on disk.
+// Data and metadata alike are written by the time the
+// operation that wrote them commits, so this waits for
+// the commit.
+int
+filesync(struct file *f)
+{
+  if(f->type != FD_INODE)
+    return -1;
+  log_sync();
+  return 0;
+}
+
 // Get metadata about file f.
 // addr is a user virtual address, pointing to a struct stat.
 int
@@ -129,6 +146,43 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
+// Set the offset of file f, relative to the start of the file,
+// the current offset or the end of the file according to whence,
+// or to the first data or hole at or after off for SEEK_DATA and
+// SEEK_HOLE. The offset may lie past the end of the file; a write
+// there leaves a hole.
+// Returns the new offset, or -1 if f is not seekable or the new
+// offset would be negative.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  int base, r;
+
+  if(f->type != FD_INODE)
+    return -1;
+
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    base = -1;
+
+  r = -1;
+  if(whence == SEEK_DATA || whence == SEEK_HOLE){
+    if(off >= 0 && (r = iseekhole(f->ip, off, whence == SEEK_HOLE)) >= 0)
+      f->off = r;
+  } else if(base >= 0 && base + off >= 0 && base + off <= MAXFILE*BSIZE){
+    f->off = base + off;
+    r = f->off;
+  }
+  iunlock(f->ip);
+  return r;
+}
+
 // Write to file f.
 // addr is a user virtual address.
 int
@@ -161,6 +215,12 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
+      // a compressed file is written a cluster at a time.
+      if(f->ip->flags & DI_COMPRESS){
+        n1 = CLUSTERSIZE - f->off % CLUSTERSIZE;
+        if(n1 > n - i)
+          n1 = n - i;
+      }
       if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
@@ -3,6 +3,7 @@ struct file {
   int ref; // reference count
   char readable;
   char writable;
+  char synconclose;  // O_SYNCCLOSE
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
@@ -24,6 +25,7 @@ struct inode {
   short type;         // copy of disk inode
   short major;
   short minor;
+  ushort flags;
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
@@ -22,10 +22,70 @@
 #include "file.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
-// there should be one superblock per disk device, but we run with
-// only one device
+// superblock of the root file system, on ROOTDEV.
+// mounted file systems keep theirs in the mount table.
 struct superblock sb; 
 
+// what holes in files read as.
+static char zeroes[BSIZE];
+
+// orphans.added tells truncd of new entries in the orphan block.
+struct {
+  struct spinlock lock;
+  int added;
+} orphans;
+
+static int iorphan(struct inode*);
+static void truncd(void);
+
+// Decompressed clusters of compressed files. An entry's data
+// belongs to whoever holds a reference, and they hold the
+// inode's lock; ccache.lock protects the rest.
+struct {
+  struct spinlock lock;
+  uint tick;
+  struct ccluster {
+    uint dev;     // 0 if unused
+    uint inum;
+    uint cno;     // cluster number in the file
+    int ref;
+    int valid;    // has data been read from disk?
+    uint used;    // tick of the last use, for eviction
+    uchar data[CLUSTERSIZE];
+  } c[NCCACHE];
+} ccache;
+
+static void ccinval(uint, uint);
+
+// Mount table. A mounted file system covers a directory of
+// another file system: path lookups that reach the covered
+// directory continue at the mounted root, and ".." at the
+// mounted root leads back to the covered directory.
+// mtable.lock protects the table; entries are never removed.
+struct {
+  struct spinlock lock;
+  struct mount {
+    int used;               // entry allocated?
+    uint dev;               // device of the mounted file system
+    struct inode *covered;  // directory it is mounted on
+    struct superblock sb;
+  } mount[NMOUNT];
+} mtable;
+
+// Return the superblock of the file system on dev.
+static struct superblock*
+devsb(uint dev)
+{
+  struct mount *m;
+
+  if(dev == ROOTDEV)
+    return &sb;
+  for(m = mtable.mount; m < &mtable.mount[NMOUNT]; m++)
+    if(m->covered && m->dev == dev)
+      return &m->sb;
+  panic("devsb");
+}
+
 // Read the super block.
 static void
 readsb(int dev, struct superblock *sb)
@@ -40,10 +100,14 @@ readsb(int dev, struct superblock *sb)
 // Init fs
 void
 fsinit(int dev) {
+  initlock(&mtable.lock, "mtable");
   readsb(dev, &sb);
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  initlock(&orphans.lock, "orphans");
+  if(sb.orphanstart && kthread("truncd", truncd) < 0)
+    panic("fsinit: truncd");
 }
 
 // Zero a block.
@@ -60,24 +124,28 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a disk block, zeroed on disk if zero is set;
+// otherwise the caller must write all of it.
 // returns 0 if out of disk space.
 static uint
-balloc(uint dev)
+balloc(uint dev, int zero)
 {
   int b, bi, m;
   struct buf *bp;
 
+  struct superblock *s = devsb(dev);
+
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
+  for(b = 0; b < s->size; b += BPB){
+    bp = bread(dev, BBLOCK(b, (*s)));
+    for(bi = 0; bi < BPB && b + bi < s->size; bi++){
       m = 1 << (bi % 8);
       if((bp->data[bi/8] & m) == 0){  // Is block free?
         bp->data[bi/8] |= m;  // Mark block in use.
         log_write(bp);
         brelse(bp);
-        bzero(dev, b + bi);
+        if(zero)
+          bzero(dev, b + bi);
         return b + bi;
       }
     }
@@ -87,18 +155,65 @@ balloc(uint dev)
   return 0;
 }
 
-// Free a disk block.
+// Reference counts.
+//
+// clone() lets files share data blocks; the refcount map
+// (sb.refstart) counts, per block, the owners beyond the first.
+// bfree() of a shared block just drops a reference, and
+// writei() copies a shared block before writing it.
+
+// Number of owners of block b beyond the first.
+static int
+brefs(uint dev, uint b)
+{
+  struct superblock *s = devsb(dev);
+  struct buf *bp;
+  int n;
+
+  if(s->refstart == 0)
+    return 0;
+  bp = bread(dev, RBLOCK(b, (*s)));
+  n = bp->data[b % BSIZE];
+  brelse(bp);
+  return n;
+}
+
+// Add delta to the number of owners of block b.
+static void
+bref(uint dev, uint b, int delta)
+{
+  struct superblock *s = devsb(dev);
+  struct buf *bp;
+
+  bp = bread(dev, RBLOCK(b, (*s)));
+  bp->data[b % BSIZE] += delta;
+  log_write(bp);
+  brelse(bp);
+}
+
+// Free a disk block, or drop a reference to a shared one.
 static void
 bfree(int dev, uint b)
 {
   struct buf *bp;
   int bi, m;
 
-  bp = bread(dev, BBLOCK(b, sb));
+  if(brefs(dev, b) > 0){
+    // the other owners must not write it in place until this
+    // commits, or a crash could give it back this owner's view.
+    log_free(dev);
+    bref(dev, b, -1);
+    return;
+  }
+
+  bp = bread(dev, BBLOCK(b, (*devsb(dev))));
   bi = b % BPB;
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
+  // before the bit is clear: whoever allocates the block next
+  // must see the free and not write it in place.
+  log_free(dev);
   bp->data[bi/8] &= ~m;
   log_write(bp);
   brelse(bp);
@@ -184,6 +299,7 @@ iinit()
   int i = 0;
   
   initlock(&itable.lock, "itable");
+  initlock(&ccache.lock, "ccache");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
@@ -201,15 +317,17 @@ ialloc(uint dev, short type)
   int inum;
   struct buf *bp;
   struct dinode *dip;
+  struct superblock *s = devsb(dev);
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
+  for(inum = 1; inum < s->ninodes; inum++){
+    bp = bread(dev, IBLOCK(inum, (*s)));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
+      ccinval(dev, inum);
       return iget(dev, inum);
     }
     brelse(bp);
@@ -228,11 +346,12 @@ iupdate(struct inode *ip)
   struct buf *bp;
   struct dinode *dip;
 
-  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+  bp = bread(ip->dev, IBLOCK(ip->inum, (*devsb(ip->dev))));
   dip = (struct dinode*)bp->data + ip->inum%IPB;
   dip->type = ip->type;
   dip->major = ip->major;
   dip->minor = ip->minor;
+  dip->flags = ip->flags;
   dip->nlink = ip->nlink;
   dip->size = ip->size;
   memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
@@ -301,11 +420,12 @@ ilock(struct inode *ip)
   acquiresleep(&ip->lock);
 
   if(ip->valid == 0){
-    bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    bp = bread(ip->dev, IBLOCK(ip->inum, (*devsb(ip->dev))));
     dip = (struct dinode*)bp->data + ip->inum%IPB;
     ip->type = dip->type;
     ip->major = dip->major;
     ip->minor = dip->minor;
+    ip->flags = dip->flags;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
@@ -347,10 +467,12 @@ iput(struct inode *ip)
 
     release(&itable.lock);
 
-    itrunc(ip);
-    ip->type = 0;
-    iupdate(ip);
-    ip->valid = 0;
+    if(iorphan(ip) < 0){
+      itrunc(ip);
+      ip->type = 0;
+      iupdate(ip);
+      ip->valid = 0;
+    }
 
     releasesleep(&ip->lock);
 
@@ -376,21 +498,44 @@ iunlockput(struct inode *ip)
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
+// Return the disk block address of the nth block in inode ip,
+// or 0 if that block is a hole. Never allocates.
+static uint
+bmapget(struct inode *ip, uint bn)
+{
+  uint addr;
+  struct buf *bp;
+
+  if(bn < NDIRECT)
+    return ip->addrs[bn];
+  bn -= NDIRECT;
+  if(bn >= NINDIRECT || (addr = ip->addrs[NDIRECT]) == 0)
+    return 0;
+  bp = bread(ip->dev, addr);
+  addr = ((uint*)bp->data)[bn];
+  brelse(bp);
+  return addr;
+}
+
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one. If fresh is
+// not 0, a new block is not zeroed, and *fresh is set: the
+// caller must write all of it.
 // returns 0 if out of disk space.
 static uint
-bmap(struct inode *ip, uint bn)
+bmap(struct inode *ip, uint bn, int *fresh)
 {
   uint addr, *a;
   struct buf *bp;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, fresh == 0);
       if(addr == 0)
         return 0;
       ip->addrs[bn] = addr;
+      if(fresh)
+        *fresh = 1;
     }
     return addr;
   }
@@ -399,7 +544,7 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, 1);
       if(addr == 0)
         return 0;
       ip->addrs[NDIRECT] = addr;
@@ -407,10 +552,12 @@ bmap(struct inode *ip, uint bn)
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, fresh == 0);
       if(addr){
         a[bn] = addr;
         log_write(bp);
+        if(fresh)
+          *fresh = 1;
       }
     }
     brelse(bp);
@@ -420,6 +567,22 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Point ip's block bn, which must be mapped, at addr.
+static void
+bmapset(struct inode *ip, uint bn, uint addr)
+{
+  struct buf *bp;
+
+  if(bn < NDIRECT){
+    ip->addrs[bn] = addr;
+    return;
+  }
+  bp = bread(ip->dev, ip->addrs[NDIRECT]);
+  ((uint*)bp->data)[bn - NDIRECT] = addr;
+  log_write(bp);
+  brelse(bp);
+}
+
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
 void
@@ -429,6 +592,11 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  if(ip->flags & DI_INLINE){
+    memset(ip->addrs, 0, sizeof(ip->addrs));
+    ip->flags &= ~DI_INLINE;
+  }
+
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -450,6 +618,194 @@ itrunc(struct inode *ip)
 
   ip->size = 0;
   iupdate(ip);
+  ccinval(ip->dev, ip->inum);
+}
+
+// Orphans.
+//
+// Freeing the blocks of a big file means a bfree() per block,
+// all in the caller's transaction. Instead, iput() of an
+// unlinked file with an indirect block makes it an orphan: it
+// lists the inode in the orphan block and leaves it allocated,
+// and the kernel thread truncd frees its blocks later, a few
+// per transaction, and then the inode. The orphan block is
+// updated in the same transactions, so after a crash truncd
+// finishes whatever it was given. itruncdefer() does the same
+// for O_TRUNC by moving the blocks to a new, unlinked inode.
+// Only the root file system, the one with the log, has orphans.
+
+// blocks freed per truncd transaction: each bfree() may log a
+// different bitmap block, besides the inode and indirect block.
+#define NTRUNC (MAXOPBLOCKS - 2)
+
+// Make ip, which has no links or other references, an orphan.
+// Returns -1 if it is small, or there is no room in the orphan
+// block, and the caller must free it now.
+// Caller must hold ip->lock and be in a transaction.
+static int
+iorphan(struct inode *ip)
+{
+  struct buf *bp;
+  uint *a;
+  int i;
+
+  if(ip->dev != ROOTDEV || sb.orphanstart == 0 || (ip->flags & DI_INLINE) ||
+     ip->addrs[NDIRECT] == 0)
+    return -1;
+
+  bp = bread(ip->dev, sb.orphanstart);
+  a = (uint*)bp->data;
+  for(i = 0; i < NORPHAN && a[i] != 0; i++)
+    ;
+  if(i == NORPHAN){
+    brelse(bp);
+    return -1;
+  }
+  a[i] = ip->inum;
+  log_write(bp);
+  brelse(bp);
+
+  acquire(&orphans.lock);
+  orphans.added = 1;
+  wakeup(&orphans);
+  release(&orphans.lock);
+  return 0;
+}
+
+// Truncate ip like itrunc(), but if it is big leave the work to
+// truncd, by moving its blocks to a new orphan.
+// Caller must hold ip->lock and be in a transaction.
+void
+itruncdefer(struct inode *ip)
+{
+  struct inode *op;
+
+  if(ip->dev != ROOTDEV || sb.orphanstart == 0 || (ip->flags & DI_INLINE) ||
+     ip->addrs[NDIRECT] == 0 || (op = ialloc(ip->dev, T_FILE)) == 0){
+    itrunc(ip);
+    return;
+  }
+  ilock(op);
+  memmove(op->addrs, ip->addrs, sizeof(ip->addrs));
+  op->size = ip->size;
+  iupdate(op);
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+  ip->size = 0;
+  iupdate(ip);
+  ccinval(ip->dev, ip->inum);
+  iunlockput(op);  // no links: iput() makes it an orphan.
+}
+
+// Free up to max of ip's blocks, the last ones first, so that
+// ip is consistent after each call; the indirect block goes
+// once it maps nothing. Returns the number freed, 0 when ip
+// has no blocks left.
+// Caller must hold ip->lock and be in a transaction.
+static int
+itruncsome(struct inode *ip, int max)
+{
+  struct buf *bp;
+  uint *a;
+  int i, n = 0;
+
+  if(ip->addrs[NDIRECT]){
+    bp = bread(ip->dev, ip->addrs[NDIRECT]);
+    a = (uint*)bp->data;
+    for(i = NINDIRECT-1; i >= 0 && n < max; i--){
+      if(a[i]){
+        bfree(ip->dev, a[i]);
+        a[i] = 0;
+        n++;
+      }
+    }
+    if(n > 0)
+      log_write(bp);
+    brelse(bp);
+    if(i < 0 && n < max){
+      bfree(ip->dev, ip->addrs[NDIRECT]);
+      ip->addrs[NDIRECT] = 0;
+      n++;
+    }
+  }
+  for(i = NDIRECT-1; i >= 0 && n < max; i--){
+    if(ip->addrs[i]){
+      bfree(ip->dev, ip->addrs[i]);
+      ip->addrs[i] = 0;
+      n++;
+    }
+  }
+  if(n > 0)
+    iupdate(ip);
+  return n;
+}
+
+// Remove inum from the orphan block.
+// Caller must be in a transaction.
+static void
+orphandone(uint inum)
+{
+  struct buf *bp;
+  uint *a;
+  int i;
+
+  bp = bread(ROOTDEV, sb.orphanstart);
+  a = (uint*)bp->data;
+  for(i = 0; i < NORPHAN; i++){
+    if(a[i] == inum){
+      a[i] = 0;
+      log_write(bp);
+      break;
+    }
+  }
+  brelse(bp);
+}
+
+// Kernel thread that frees orphans, including any left by a
+// crash.
+static void
+truncd(void)
+{
+  struct inode *ip;
+  struct buf *bp;
+  uint inum, *a;
+  int i, n;
+
+  for(;;){
+    bp = bread(ROOTDEV, sb.orphanstart);
+    a = (uint*)bp->data;
+    for(inum = 0, i = 0; i < NORPHAN && inum == 0; i++)
+      inum = a[i];
+    brelse(bp);
+
+    if(inum == 0){
+      acquire(&orphans.lock);
+      while(orphans.added == 0)
+        sleep(&orphans, &orphans.lock);
+      orphans.added = 0;
+      release(&orphans.lock);
+      continue;
+    }
+
+    ip = iget(ROOTDEV, inum);
+    do {
+      begin_op();
+      ilock(ip);
+      if((n = itruncsome(ip, NTRUNC)) == 0){
+        // no blocks left: free the inode, and it is no
+        // longer an orphan.
+        ip->size = 0;
+        ip->type = 0;
+        iupdate(ip);
+        ip->valid = 0;
+        orphandone(inum);
+      }
+      iunlock(ip);
+      end_op();
+    } while(n > 0);
+    begin_op();
+    iput(ip);
+    end_op();
+  }
 }
 
 // Copy stat information from inode.
@@ -457,11 +813,175 @@ itrunc(struct inode *ip)
 void
 stati(struct inode *ip, struct stat *st)
 {
+  struct buf *bp;
+  uint *a;
+  int i;
+
   st->dev = ip->dev;
   st->ino = ip->inum;
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+  st->blocks = 0;
+  if(ip->type == T_DEVICE || (ip->flags & DI_INLINE))
+    return;
+  for(i = 0; i < NDIRECT; i++)
+    if(ip->addrs[i])
+      st->blocks++;
+  if(ip->addrs[NDIRECT]){
+    // the indirect block, read once, and the blocks it maps.
+    st->blocks++;
+    bp = bread(ip->dev, ip->addrs[NDIRECT]);
+    a = (uint*)bp->data;
+    for(i = 0; i < NINDIRECT; i++)
+      if(a[i])
+        st->blocks++;
+    brelse(bp);
+  }
+}
+
+// Return the offset of the first byte at or after off that
+// lies in a hole (hole set) or in data (hole clear), for
+// SEEK_HOLE and SEEK_DATA; the end of the file counts as a
+// hole. Returns -1 if there is none, or if off is not before
+// the end of the file.
+// Caller must hold ip->lock.
+int
+iseekhole(struct inode *ip, uint off, int hole)
+{
+  uint bn, step;
+
+  if(off >= ip->size)
+    return -1;
+  if(ip->flags & DI_INLINE)
+    return hole ? ip->size : off;
+  // a compressed cluster with data has its first block.
+  step = (ip->flags & DI_COMPRESS) ? NCLUSTER : 1;
+  for(bn = off/BSIZE/step*step; bn*BSIZE < ip->size; bn += step){
+    if((bmapget(ip, bn) == 0) == hole)
+      return bn*BSIZE > off ? bn*BSIZE : off;
+  }
+  return hole ? ip->size : -1;
+}
+
+// Compressed files.
+//
+// A file opened with O_COMPRESS while empty keeps its data in
+// compressed clusters (see NCLUSTER in fs.h). readi() copies
+// out of ccache, which holds clusters decompressed; writei()
+// writes into the cached cluster and then writes the cluster
+// back, compressed again. Callers give writei() at most a
+// cluster per transaction.
+
+// Forget the cached clusters of inode inum, whose data is
+// going away.
+static void
+ccinval(uint dev, uint inum)
+{
+  struct ccluster *c;
+
+  acquire(&ccache.lock);
+  for(c = ccache.c; c < ccache.c + NCCACHE; c++){
+    if(c->dev == dev && c->inum == inum){
+      c->dev = 0;
+      c->valid = 0;
+    }
+  }
+  release(&ccache.lock);
+}
+
+// Read cluster cno of ip into data, decompressing it.
+// Returns -1 if it is not valid compressed data.
+static int
+cload(struct inode *ip, uint cno, uchar *data)
+{
+  uint addr[NCLUSTER], clen;
+  struct buf *bp;
+  uchar *page;
+  int i, k, n;
+
+  for(k = 0; k < NCLUSTER && (addr[k] = bmapget(ip, cno*NCLUSTER + k)) != 0; k++)
+    ;
+  memset(data, 0, CLUSTERSIZE);
+  if(k == 0)
+    return 0;  // a hole
+  if(k == NCLUSTER){
+    // kept as is.
+    for(i = 0; i < k; i++){
+      bp = bread(ip->dev, addr[i]);
+      memmove(data + i*BSIZE, bp->data, BSIZE);
+      brelse(bp);
+    }
+    return 0;
+  }
+
+  if((page = kalloc()) == 0)
+    return -1;
+  for(i = 0; i < k; i++){
+    bp = bread(ip->dev, addr[i]);
+    memmove(page + i*BSIZE, bp->data, BSIZE);
+    brelse(bp);
+  }
+  clen = *(uint*)page;
+  n = -1;
+  if(clen <= k*BSIZE - sizeof(uint))
+    n = lzdecompress(page + sizeof(uint), clen, data, CLUSTERSIZE);
+  kfree(page);
+  return n < 0 ? -1 : 0;
+}
+
+static void
+cput(struct ccluster *c)
+{
+  acquire(&ccache.lock);
+  c->ref--;
+  c->used = ++ccache.tick;
+  if(c->ref == 0)
+    wakeup(&ccache);
+  release(&ccache.lock);
+}
+
+// Return a referenced cache entry holding cluster cno of ip,
+// or 0 if the cluster cannot be read. Waits if every entry is
+// in use.
+// Caller must hold ip->lock.
+static struct ccluster*
+cget(struct inode *ip, uint cno)
+{
+  struct ccluster *c, *victim;
+
+  acquire(&ccache.lock);
+  for(;;){
+    victim = 0;
+    for(c = ccache.c; c < ccache.c + NCCACHE; c++){
+      if(c->dev == ip->dev && c->inum == ip->inum && c->cno == cno)
+        break;
+      if(c->ref == 0 && (victim == 0 || c->used < victim->used))
+        victim = c;
+    }
+    if(c < ccache.c + NCCACHE)
+      break;
+    if(victim){
+      c = victim;
+      c->dev = ip->dev;
+      c->inum = ip->inum;
+      c->cno = cno;
+      c->valid = 0;
+      break;
+    }
+    sleep(&ccache, &ccache.lock);
+  }
+  c->ref++;
+  release(&ccache.lock);
+
+  if(!c->valid){
+    if(cload(ip, cno, c->data) < 0){
+      cput(c);
+      return 0;
+    }
+    c->valid = 1;
+  }
+  return c;
 }
 
 // Read data from inode.
@@ -473,18 +993,46 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
+  struct ccluster *c;
+  int r;
 
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
 
+  if(ip->flags & DI_INLINE){
+    if(either_copyout(user_dst, dst, (char*)ip->addrs + off, n) == -1)
+      return -1;
+    return n;
+  }
+
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
-      break;
-    bp = bread(ip->dev, addr);
+    if(ip->flags & DI_COMPRESS){
+      m = min(n - tot, CLUSTERSIZE - off%CLUSTERSIZE);
+      if((c = cget(ip, off/CLUSTERSIZE)) == 0){
+        tot = -1;
+        break;
+      }
+      r = either_copyout(user_dst, dst, c->data + off%CLUSTERSIZE, m);
+      cput(c);
+      if(r == -1){
+        tot = -1;
+        break;
+      }
+      continue;
+    }
+    uint addr = bmapget(ip, off/BSIZE);
     m = min(n - tot, BSIZE - off%BSIZE);
+    if(addr == 0){
+      // a hole reads as zeroes, without touching the disk.
+      if(either_copyout(user_dst, dst, zeroes, m) == -1){
+        tot = -1;
+        break;
+      }
+      continue;
+    }
+    bp = bread(ip->dev, addr);
     if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
       brelse(bp);
       tot = -1;
@@ -495,6 +1043,273 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Write bp, a block of ip's data: straight to its home
+// location if log_direct() allows, else through the log.
+static void
+iwrite(struct inode *ip, struct buf *bp)
+{
+  if(ip->type == T_FILE && log_direct(ip->dev))
+    bwrite(bp);
+  else
+    log_write(bp);
+}
+
+// Does ip hold no blocks?
+static int
+inoblocks(struct inode *ip)
+{
+  for(int i = 0; i < NDIRECT+1; i++)
+    if(ip->addrs[i])
+      return 0;
+  return 1;
+}
+
+// Move ip's inline data to a block of its own, for a write
+// that will not fit in the inode. Returns -1, with ip
+// unchanged, if the disk is full.
+static int
+iuninline(struct inode *ip)
+{
+  char data[INLINESIZE];
+  struct buf *bp;
+  uint addr;
+  int fresh = 0;
+
+  memmove(data, ip->addrs, INLINESIZE);
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+  ip->flags &= ~DI_INLINE;
+  if(ip->size == 0)
+    return 0;
+  if((addr = bmap(ip, 0, &fresh)) == 0){
+    memmove(ip->addrs, data, INLINESIZE);
+    ip->flags |= DI_INLINE;
+    return -1;
+  }
+  bp = bzeroed(ip->dev, addr);
+  memmove(bp->data, data, ip->size);
+  iwrite(ip, bp);
+  brelse(bp);
+  return 0;
+}
+
+// ip's block bn, at addr, is shared with a clone: give ip a
+// copy of its own. Returns the copy, locked, for the caller to
+// write, or 0 if the disk is full.
+static struct buf*
+icow(struct inode *ip, uint bn, uint addr)
+{
+  struct buf *bp, *obp;
+  uint nb;
+
+  if((nb = balloc(ip->dev, 0)) == 0)
+    return 0;
+  obp = bread(ip->dev, addr);
+  bp = bzeroed(ip->dev, nb);
+  memmove(bp->data, obp->data, BSIZE);
+  brelse(obp);
+  bmapset(ip, bn, nb);
+  bfree(ip->dev, addr);  // drops ip's reference
+  return bp;
+}
+
+// map blocks one clone may touch, with the blocks that
+// creating the new file and its indirect block take.
+#define NCLONEREF (MAXOPBLOCKS - 7)
+
+// Make dst, an empty regular file, a clone of src: it shares
+// src's data blocks until either file writes them, and gets a
+// copy of the indirect block. Returns -1 if the blocks cannot
+// be shared: no refcount map, a count that would overflow, or
+// blocks spread over too much of the map for one transaction.
+// Caller must hold both locks and be in a transaction.
+int
+iclone(struct inode *src, struct inode *dst)
+{
+  struct superblock *s = devsb(src->dev);
+  struct buf *bp, *nbp;
+  uint bn, b, lo = ~0, hi = 0, nb;
+
+  if(src->dev != dst->dev || dst->size != 0 || (dst->flags & DI_INLINE) ||
+     inoblocks(dst) != 0)
+    return -1;
+
+  if(src->flags & DI_INLINE){
+    memmove(dst->addrs, src->addrs, sizeof(src->addrs));
+    dst->flags |= DI_INLINE;
+    dst->size = src->size;
+    iupdate(dst);
+    return 0;
+  }
+
+  if(s->refstart == 0)
+    return -1;
+  for(bn = 0; bn < MAXFILE; bn++){
+    if((b = bmapget(src, bn)) == 0)
+      continue;
+    if(brefs(src->dev, b) == 0xFF)
+      return -1;
+    lo = min(lo, b);
+    hi = b > hi ? b : hi;
+  }
+  if(lo <= hi && hi/BSIZE - lo/BSIZE + 1 > NCLONEREF)
+    return -1;
+
+  if(src->addrs[NDIRECT]){
+    if((nb = balloc(src->dev, 0)) == 0)
+      return -1;
+    bp = bread(src->dev, src->addrs[NDIRECT]);
+    nbp = bzeroed(src->dev, nb);
+    memmove(nbp->data, bp->data, BSIZE);
+    log_write(nbp);
+    brelse(nbp);
+    brelse(bp);
+    dst->addrs[NDIRECT] = nb;
+  }
+  memmove(dst->addrs, src->addrs, NDIRECT * sizeof(uint));
+  for(bn = 0; bn < MAXFILE; bn++)
+    if((b = bmapget(src, bn)) != 0)
+      bref(src->dev, b, 1);
+  dst->flags = (dst->flags & ~DI_COMPRESS) | (src->flags & DI_COMPRESS);
+  dst->size = src->size;
+  iupdate(dst);
+  return 0;
+}
+
+// The most blocks one cstore() can log, with the inode that
+// cwritei() updates after it. each of the NCLUSTER slots either
+// gets a new block, which sets a bitmap bit and may drop a
+// reference to a shared old block, or frees its old block, which
+// clears a bitmap bit or drops a reference; a new indirect block
+// sets one more bit. so the bitmap blocks are at most NCLUSTER+1
+// and the refcount map blocks at most NCLUSTER, but neither more
+// than the image has. with the data blocks, the indirect block
+// and the inode, the default image needs 4+1+1+1+2 = 9. filewrite()
+// writes one cluster per transaction, so files are compressed
+// only when this fits in MAXOPBLOCKS.
+static int
+cbudget(uint dev)
+{
+  struct superblock *s = devsb(dev);
+  int nbitmap = s->size/BPB + 1, nref = s->refstart ? s->size/BSIZE + 1 : 0;
+
+  return NCLUSTER + 1 + 1 + min(nbitmap, NCLUSTER+1) + min(nref, NCLUSTER);
+}
+
+// Write cluster cno of ip from the first len bytes of data,
+// compressed if that saves a block. Blocks shared with a clone
+// are replaced, not overwritten. Returns -1, with the cluster
+// unchanged, if the disk is full.
+// Caller must hold ip->lock and be in a transaction.
+static int
+cstore(struct inode *ip, uint cno, uchar *data, uint len)
+{
+  uint bn = cno*NCLUSTER, old[NCLUSTER], new[NCLUSTER], n;
+  uchar *out, *tab, *src;
+  struct buf *bp;
+  int clen, i, k, r = -1;
+
+  if(cbudget(ip->dev) > MAXOPBLOCKS)
+    panic("cstore: log budget");
+  if((out = kalloc()) == 0)
+    return -1;
+  if((tab = kalloc()) == 0){
+    kfree(out);
+    return -1;
+  }
+  clen = lzcompress(data, len, out + sizeof(uint),
+                    (NCLUSTER-1)*BSIZE - sizeof(uint), tab);
+  kfree(tab);
+  if(clen < 0){
+    src = data;
+    n = CLUSTERSIZE;
+    k = NCLUSTER;
+  } else {
+    *(uint*)out = clen;
+    src = out;
+    n = sizeof(uint) + clen;
+    k = (n + BSIZE - 1) / BSIZE;
+  }
+
+  // allocate first, so that a full disk changes nothing.
+  if(bn >= NDIRECT && ip->addrs[NDIRECT] == 0 &&
+     (ip->addrs[NDIRECT] = balloc(ip->dev, 1)) == 0)
+    goto done;
+  for(i = 0; i < NCLUSTER; i++){
+    old[i] = bmapget(ip, bn + i);
+    new[i] = 0;
+    if(i < k && (old[i] == 0 || brefs(ip->dev, old[i]) > 0) &&
+       (new[i] = balloc(ip->dev, 0)) == 0){
+      while(--i >= 0)
+        if(new[i])
+          bfree(ip->dev, new[i]);
+      goto done;
+    }
+  }
+
+  for(i = 0; i < NCLUSTER; i++){
+    if(new[i] || (i >= k && old[i])){
+      bmapset(ip, bn + i, new[i]);
+      if(old[i])
+        bfree(ip->dev, old[i]);
+    }
+    if(i >= k)
+      continue;
+    bp = bzeroed(ip->dev, new[i] ? new[i] : old[i]);
+    memmove(bp->data, src + i*BSIZE, min(BSIZE, n - i*BSIZE));
+    log_write(bp);
+    brelse(bp);
+  }
+  r = 0;
+
+done:
+  kfree(out);
+  return r;
+}
+
+// writei() of a compressed file.
+static int
+cwritei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  struct ccluster *c;
+  uint tot, m, cno, end;
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    cno = off/CLUSTERSIZE;
+    m = min(n - tot, CLUSTERSIZE - off%CLUSTERSIZE);
+    if((c = cget(ip, cno)) == 0)
+      break;
+    end = off + m > ip->size ? off + m : ip->size;
+    if(either_copyin(c->data + off%CLUSTERSIZE, user_src, src, m) == -1 ||
+       cstore(ip, cno, c->data, min(CLUSTERSIZE, end - cno*CLUSTERSIZE)) < 0){
+      // the cached copy no longer matches the disk.
+      c->valid = 0;
+      cput(c);
+      break;
+    }
+    cput(c);
+    ip->size = end;
+  }
+  iupdate(ip);
+  return tot;
+}
+
+// Make ip, an empty regular file, keep its data compressed.
+// Returns -1 if it is not empty, or if a cluster rewrite on this
+// disk might not fit in a transaction (see cbudget()).
+// Caller must hold ip->lock and be in a transaction.
+int
+icompress(struct inode *ip)
+{
+  if(ip->flags & DI_COMPRESS)
+    return 0;
+  if(ip->type != T_FILE || ip->size != 0 || !inoblocks(ip) ||
+     cbudget(ip->dev) > MAXOPBLOCKS)
+    return -1;
+  ip->flags = (ip->flags & ~DI_INLINE) | DI_COMPRESS;
+  iupdate(ip);
+  return 0;
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -502,29 +1317,68 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 // Returns the number of bytes successfully written.
 // If the return value is less than the requested n,
 // there was an error of some kind.
+// In ordered mode the data of regular files is written
+// straight to its home location, before the transaction that
+// points the inode at it commits; see log_direct().
+// A regular file whose data fits in INLINESIZE bytes keeps it
+// in the inode, until a write makes it bigger. A block shared
+// with a clone is copied first.
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
+  int fresh, r;
 
-  if(off > ip->size || off + n < off)
+  // writing past the end leaves a hole between the old end
+  // and off: its blocks are allocated only if written.
+  if(off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  if(ip->flags & DI_COMPRESS)
+    return cwritei(ip, user_src, src, off, n);
+
+  if(ip->type == T_FILE && ip->size == 0 && off + n <= INLINESIZE &&
+     !(ip->flags & DI_INLINE) && inoblocks(ip))
+    ip->flags |= DI_INLINE;
+  if(ip->flags & DI_INLINE){
+    if(off + n <= INLINESIZE){
+      if(either_copyin((char*)ip->addrs + off, user_src, src, n) == -1)
+        n = 0;
+      if(off + n > ip->size)
+        ip->size = off + n;
+      iupdate(ip);
+      return n;
+    }
+    if(iuninline(ip) < 0)
+      return 0;
+  }
+
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    uint addr = bmap(ip, off/BSIZE);
+    fresh = 0;
+    uint addr = bmap(ip, off/BSIZE, &fresh);
     if(addr == 0)
       break;
-    bp = bread(ip->dev, addr);
+    // a new block need not be read, only zeroed in the cache,
+    // but then it must be written even if the copy fails; so
+    // must a copy of a shared block.
+    if(fresh)
+      bp = bzeroed(ip->dev, addr);
+    else if(brefs(ip->dev, addr) > 0){
+      if((bp = icow(ip, off/BSIZE, addr)) == 0)
+        break;
+      fresh = 1;
+    } else
+      bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
-      brelse(bp);
-      break;
-    }
-    log_write(bp);
+    r = either_copyin(bp->data + (off % BSIZE), user_src, src, m);
+    if(r != -1 || fresh)
+      iwrite(ip, bp);
     brelse(bp);
+    if(r == -1)
+      break;
   }
 
   if(off > ip->size)
@@ -644,6 +1498,182 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Mounts
+
+// Is ip covered by a mounted file system?
+int
+imounted(struct inode *ip)
+{
+  struct mount *m;
+  int r = 0;
+
+  acquire(&mtable.lock);
+  for(m = mtable.mount; m < &mtable.mount[NMOUNT]; m++)
+    if(m->covered == ip)
+      r = 1;
+  release(&mtable.lock);
+  return r;
+}
+
+// If ip is covered by a mounted file system,
+// return that file system's root instead.
+// Consumes the caller's reference to ip.
+static struct inode*
+mntcross(struct inode *ip)
+{
+  struct mount *m;
+  uint dev = 0;
+
+  acquire(&mtable.lock);
+  for(m = mtable.mount; m < &mtable.mount[NMOUNT]; m++){
+    if(m->covered == ip){
+      dev = m->dev;
+      break;
+    }
+  }
+  release(&mtable.lock);
+
+  if(dev == 0)
+    return ip;
+  iput(ip);  // the mount table still holds a reference.
+  return iget(dev, ROOTINO);
+}
+
+// If ip is the root of a mounted file system,
+// return the directory it covers, whose ".." is the
+// parent of the mounted root. Consumes the caller's
+// reference to ip.
+static struct inode*
+mntparent(struct inode *ip)
+{
+  struct mount *m;
+  struct inode *covered = 0;
+
+  if(ip->dev == ROOTDEV || ip->inum != ROOTINO)
+    return ip;
+
+  acquire(&mtable.lock);
+  for(m = mtable.mount; m < &mtable.mount[NMOUNT]; m++){
+    if(m->covered && m->dev == ip->dev){
+      covered = m->covered;
+      break;
+    }
+  }
+  release(&mtable.lock);
+
+  if(covered == 0)
+    return ip;
+  iput(ip);
+  return idup(covered);
+}
+
+// Write an empty file system, holding just a root
+// directory, to device dev, which has size blocks.
+// Used for RAM disks, which start out zeroed and have
+// no log.
+static void
+fsformat(uint dev, uint size, uint ninodes)
+{
+  struct superblock s;
+  struct buf *bp;
+  struct dinode *dip;
+  struct dirent *de;
+  uint datastart, b;
+
+  memset(&s, 0, sizeof(s));
+  s.magic = FSMAGIC;
+  s.size = size;
+  s.ninodes = ninodes;
+  s.nlog = 0;
+  s.logstart = 2;
+  s.inodestart = 2;
+  s.bmapstart = s.inodestart + ninodes / IPB + 1;
+  datastart = s.bmapstart + size / BPB + 1;
+  s.nblocks = size - datastart;
+
+  bp = bread(dev, 1);
+  memset(bp->data, 0, BSIZE);
+  memmove(bp->data, &s, sizeof(s));
+  bwrite(bp);
+  brelse(bp);
+
+  // mark the metadata blocks and the root directory's
+  // one data block (datastart) in use.
+  for(b = 0; b <= datastart; b++){
+    bp = bread(dev, BBLOCK(b, s));
+    bp->data[(b % BPB)/8] |= 1 << (b % 8);
+    bwrite(bp);
+    brelse(bp);
+  }
+
+  bp = bread(dev, IBLOCK(ROOTINO, s));
+  dip = (struct dinode*)bp->data + ROOTINO%IPB;
+  memset(dip, 0, sizeof(*dip));
+  dip->type = T_DIR;
+  dip->nlink = 1;
+  dip->size = 2 * sizeof(struct dirent);
+  dip->addrs[0] = datastart;
+  bwrite(bp);
+  brelse(bp);
+
+  bp = bread(dev, datastart);
+  memset(bp->data, 0, BSIZE);
+  de = (struct dirent*)bp->data;
+  de[0].inum = ROOTINO;
+  strncpy(de[0].name, ".", DIRSIZ);
+  de[1].inum = ROOTINO;
+  strncpy(de[1].name, "..", DIRSIZ);
+  bwrite(bp);
+  brelse(bp);
+}
+
+// Mount the file system on device dev over directory dp,
+// formatting it first if it holds no file system.
+// Only the RAM disk can be mounted.
+// Caller must hold dp->lock; on success the mount table
+// takes over the caller's reference to dp.
+// Returns 0 on success, -1 on failure.
+int
+fsmount(struct inode *dp, uint dev)
+{
+  struct mount *m, *free;
+  struct superblock s;
+
+  if(dev != RAMDEV || dp->type != T_DIR)
+    return -1;
+
+  acquire(&mtable.lock);
+  free = 0;
+  for(m = mtable.mount; m < &mtable.mount[NMOUNT]; m++){
+    if(m->used && (m->dev == dev || m->covered == dp)){
+      release(&mtable.lock);
+      return -1;
+    }
+    if(!m->used && free == 0)
+      free = m;
+  }
+  if(free == 0){
+    release(&mtable.lock);
+    return -1;
+  }
+  // reserve the entry; lookups ignore it until covered is set.
+  free->used = 1;
+  free->dev = dev;
+  release(&mtable.lock);
+
+  readsb(dev, &s);
+  if(s.magic != FSMAGIC){
+    fsformat(dev, RAMDISKSIZE, RAMDISKINODES);
+    readsb(dev, &s);
+  }
+
+  acquire(&mtable.lock);
+  free->sb = s;
+  free->covered = dp;
+  release(&mtable.lock);
+  return 0;
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
@@ -659,6 +1689,8 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
+    if(namecmp(name, "..") == 0)
+      ip = mntparent(ip);
     ilock(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
@@ -674,7 +1706,7 @@ namex(char *path, int nameiparent, char *name)
       return 0;
     }
     iunlockput(ip);
-    ip = next;
+    ip = mntcross(next);
   }
   if(nameiparent){
     iput(ip);
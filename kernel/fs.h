@@ -7,7 +7,10 @@
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//   free bit map | orphan block | refcount map | data blocks ]
+//
+// The orphan block and refcount map are optional (orphanstart
+// and refstart 0); a formatted RAM disk has neither.
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -20,6 +23,8 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint orphanstart;  // Block number of the orphan block, or 0
+  uint refstart;     // Block number of first refcount map block, or 0
 };
 
 #define FSMAGIC 0x10203040
@@ -31,13 +36,29 @@ struct superblock {
 // On-disk inode structure
 struct dinode {
   short type;           // File type
-  short major;          // Major device number (T_DEVICE only)
-  short minor;          // Minor device number (T_DEVICE only)
+  uchar major;          // Major device number (T_DEVICE only)
+  uchar minor;          // Minor device number (T_DEVICE only)
+  ushort flags;         // DI_ flags
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint addrs[NDIRECT+1];   // Data block addresses, or DI_INLINE data
 };
 
+// dinode flags
+#define DI_INLINE 0x1   // a small file's data is in addrs[], not in blocks
+#define DI_COMPRESS 0x2 // data is stored in compressed clusters
+
+// Largest file whose data can be kept in its inode.
+#define INLINESIZE (sizeof(uint) * (NDIRECT+1))
+
+// A compressed file's data is compressed a cluster of NCLUSTER
+// blocks at a time, kept in the cluster's first blocks after a
+// uint with its compressed length; a cluster that would not
+// save a block is kept as is, and has all its blocks. A cluster
+// is rewritten in one transaction, so NCLUSTER is small.
+#define NCLUSTER      4
+#define CLUSTERSIZE   (NCLUSTER * BSIZE)
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -50,6 +71,15 @@ struct dinode {
 // Block of free map containing bit for block b
 #define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
 
+// The orphan block lists, as uints, the inodes whose blocks
+// are waiting to be freed; 0 marks an empty slot.
+#define NORPHAN       (BSIZE / sizeof(uint))
+
+// The refcount map has a byte per block: the number of clones
+// that share the block besides its first owner.
+// Block of the refcount map containing the byte for block b
+#define RBLOCK(b, sb) ((b)/BSIZE + sb.refstart)
+
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
 
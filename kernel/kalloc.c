@@ -7,15 +7,18 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "kstat.h"
 #include "defs.h"
 
 /*
 kernel memory layout
 
-+------------------+ 0x88000000 (PHYSTOP)
++------------------+ phystop (from the device tree)
 |                  |
 |    Free memory   | RW-
 |                  |
++------------------+ freestart
+| page_ref_count[] | RW-
 +------------------+ end
 |   Kernel data    | RW-
 +------------------+
@@ -23,12 +26,14 @@ kernel memory layout
 +------------------+ 0x80000000 (KERNBASE)
 */
 
-// user programs can only use the Free memory, however kernel data/text size will only be determined at runtime, hence also the case for end
-// so we have to use the info that is available during compile time to decide the size of page reference count array
-#define MAXNPAGES (PHYSTOP - KERNBASE)/PGSIZE
-#define PA2INDEX(pa) ((uint64)pa - PGROUNDUP((uint64)end)) / PGSIZE
+// page_ref_count[] has an entry for every page from KERNBASE to
+// phystop; phystop is only known at boot, so kinit() carves the
+// array out of the start of free memory.
+#define PA2INDEX(pa) (((uint64)pa - KERNBASE) / PGSIZE)
 // Number of pages the current CPU will get from other CPU if its is empty
 #define NPGTOMOVE 10
+// a CPU's cache holding more than this gives NPGTOMOVE back to its node
+#define NPGCACHE (8*NPGTOMOVE)
 #define MIN(a, b) (a < b) ? a : b
 
 void freerange(void *pa_start, void *pa_end);
@@ -41,32 +46,58 @@ struct run {
   struct run *next;
 };
 
+// free pages of each NUMA node, shared by the node's CPUs.
 struct {
   struct spinlock lock;
   struct run *freelist;
   int size;
+} knodes[NNUMA];
+
+// per-CPU caches, holding only pages of the CPU's own node.
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+  int size;
+  uint64 nlocal;   // pages kalloc()ed from this CPU's node
+  uint64 nremote;  // pages kalloc()ed from another node
+  uint64 nfree;    // pages kfree()d
+  uint64 nsteal;   // successful move_freelist()s into this cache
 } kmems[NCPU] = {
   [0 ... NCPU-1] = { .freelist = 0, .size = 0 }
 };
 
-// only (PHYSTOP-end)/PGSIZE of entries will be used, since they corresponde to the free memroy
-int page_ref_count[MAXNPAGES];
+int *page_ref_count;
+char *freestart;   // first page after page_ref_count[]
 int is_initializing = 1;
+uint64 npages;     // pages handed to the allocator by kinit()
 
 void
 kinit()
 {
+  uint64 start, stop, nref;
+
   initlocks();
-  // The 1st cpu called kinit will get all physical memory initially
-  freerange(end, (void*)PHYSTOP);
-  memset(page_ref_count, 0, sizeof(int) * MAXNPAGES);
+  nref = (phystop - KERNBASE) / PGSIZE;
+  page_ref_count = (int*)PGROUNDUP((uint64)end);
+  freestart = (char*)PGROUNDUP((uint64)page_ref_count + nref*sizeof(int));
+  memset(page_ref_count, 0, nref*sizeof(int));
+
+  // hand each range of RAM to its node's free list.
+  for(int i = 0; memrangeget(i, &start, &stop); i++){
+    if(start < (uint64)freestart)
+      start = (uint64)freestart;
+    if(start < stop)
+      freerange((void*)start, (void*)stop);
+  }
   is_initializing = 0;
 }
 
 void initlocks()
 {
+  for (int i = 0; i < NNUMA; i++)
+    initlocktype(&knodes[i].lock, "knode", SPIN_TICKET);
   for (int i = 0; i < NCPU; i++)
-    initlock(&kmems[i].lock, "kmem");
+    initlocktype(&kmems[i].lock, "kmem", SPIN_TICKET);
 }
 
 void
@@ -74,14 +105,16 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
     kfree(p);
+    npages++;
+  }
 }
 
 int
-is_pa_valid(uint pa)
+is_pa_valid(uint64 pa)
 {
-  if ((pa < (uint64)end) || (pa > (uint64)PHYSTOP)) {
+  if ((pa < (uint64)freestart) || (pa > phystop)) {
     printf("invalid pa: %p while access page reference count", pa);
     return -1;
   }
@@ -115,18 +148,6 @@ int dec_page_ref(uint64 pa)
   return __sync_fetch_and_sub(&page_ref_count[PA2INDEX(pa)], 1);
 }
 
-// Disable interrupts to ensure a consistent execution context.
-// This is necessary because a context switch (caused by an interrupt) could
-// move the process to a different CPU, leading to an incorrect core number.
-int 
-safe_cpuid()
-{
-  push_off();
-  int id = cpuid();
-  pop_off();
-  return id;
-}
-
 // Move some memory from src_cpuid to dst_cpuid. This function needs to be called with locks on 
 // the two CPU's kmems acquired
 int 
@@ -152,6 +173,97 @@ move_freelist(int dst_cpuid, int src_cpuid)
   return 0;
 }
 
+// put r on its node's free list.
+static void
+nodefree(struct run *r)
+{
+  int node = pa2node((uint64)r);
+
+  acquire(&knodes[node].lock);
+  r->next = knodes[node].freelist;
+  knodes[node].freelist = r;
+  knodes[node].size++;
+  release(&knodes[node].lock);
+}
+
+// take one page from node's free list, or return 0.
+static struct run*
+nodealloc(int node)
+{
+  struct run *r;
+
+  acquire(&knodes[node].lock);
+  r = knodes[node].freelist;
+  if(r){
+    knodes[node].freelist = r->next;
+    knodes[node].size--;
+  }
+  release(&knodes[node].lock);
+  return r;
+}
+
+// refill CPU id's empty cache with pages of its own node:
+// first from the node's free list, else from another CPU
+// of the node. caller holds kmems[id].lock.
+static void
+refill(int id, int node)
+{
+  struct run *r;
+  int n;
+
+  acquire(&knodes[node].lock);
+  for(n = 0; n < NPGTOMOVE && (r = knodes[node].freelist) != 0; n++){
+    knodes[node].freelist = r->next;
+    knodes[node].size--;
+    r->next = kmems[id].freelist;
+    kmems[id].freelist = r;
+    kmems[id].size++;
+  }
+  release(&knodes[node].lock);
+  if(n > 0)
+    return;
+
+  // No free memory in the node's list, need to borrow from other CPUs of the node
+  for (int i = 0; i < NCPU; i++) {
+    if (i != id && cpunode(i) == node && kmems[i].freelist) {
+      acquire(&kmems[i].lock);
+      if (move_freelist(id, i) == 0) {
+        // got some free memory from i, we can start alloc memory from it
+        kmems[id].nsteal++;
+        release(&kmems[i].lock);
+        break;
+      } 
+      release(&kmems[i].lock);
+    }
+  }
+}
+
+// the local node is out of memory: take a page from
+// any other node's free list or CPU cache.
+static struct run*
+remotealloc(int node)
+{
+  struct run *r;
+
+  for(int n = 0; n < numanodes(); n++)
+    if(n != node && (r = nodealloc(n)) != 0)
+      return r;
+  for(int i = 0; i < NCPU; i++){
+    if(cpunode(i) == node || kmems[i].freelist == 0)
+      continue;
+    acquire(&kmems[i].lock);
+    r = kmems[i].freelist;
+    if(r){
+      kmems[i].freelist = r->next;
+      kmems[i].size--;
+    }
+    release(&kmems[i].lock);
+    if(r)
+      return r;
+  }
+  return 0;
+}
+
 // Free the page of physical memory pointed at by pa,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
@@ -159,10 +271,10 @@ move_freelist(int dst_cpuid, int src_cpuid)
 void
 kfree(void *pa)
 {
-  struct run *r;
+  struct run *r, *spill;
   int id;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < freestart || (uint64)pa >= phystop)
     panic("kfree");
 
   // Only need to decrement page references count if kfree is called outside of the initialization
@@ -176,40 +288,58 @@ kfree(void *pa)
 
   r = (struct run*)pa;
 
-  id = safe_cpuid();
+  push_off();
+  id = cpuid();
+  if (!is_initializing)
+    kmems[id].nfree++;
+  if (is_initializing || pa2node((uint64)pa) != cpunode(id)) {
+    pop_off();
+    nodefree(r);
+    return;
+  }
+
+  spill = 0;
   acquire(&kmems[id].lock);
   r->next = kmems[id].freelist;
   kmems[id].freelist = r;
   kmems[id].size++;
+  if (kmems[id].size > NPGCACHE) {
+    // give some back, for the node's other CPUs.
+    for (int i = 0; i < NPGTOMOVE; i++) {
+      r = kmems[id].freelist;
+      kmems[id].freelist = r->next;
+      kmems[id].size--;
+      r->next = spill;
+      spill = r;
+    }
+  }
   release(&kmems[id].lock);
+  pop_off();
+
+  for (; spill; spill = r) {
+    r = spill->next;
+    nodefree(spill);
+  }
 }
 
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
+// Prefers pages of the calling CPU's NUMA node, so
+// process memory and page tables are node-local.
 void *
 kalloc(void)
 {
   struct run *r;
-  int id;
+  int id, node;
 
-  id = safe_cpuid();
+  push_off();
+  id = cpuid();
+  node = cpunode(id);
   acquire(&kmems[id].lock);
 
-  // No free memory in the current CPU's free list, need to borrow some other CPUs
-  if (kmems[id].size == 0) {
-    for (int i = 0; i < NCPU; i++) {
-      if (i != id && kmems[i].freelist) {
-        acquire(&kmems[i].lock);
-        if (move_freelist(id, i) == 0) {
-          // got some free memory from i, we can start alloc memory from it
-          release(&kmems[i].lock);
-          break;
-        } 
-        release(&kmems[i].lock);
-      }
-    }
-  }
+  if (kmems[id].size == 0)
+    refill(id, node);
 
   r = kmems[id].freelist;
   if(r) {
@@ -218,9 +348,53 @@ kalloc(void)
   }
   release(&kmems[id].lock);
 
+  if(r == 0)
+    r = remotealloc(node);
+  if(r) {
+    if(pa2node((uint64)r) == node)
+      kmems[id].nlocal++;
+    else
+      kmems[id].nremote++;
+  }
+  pop_off();
+
   if(r) {
     memset((char*)r, 5, PGSIZE); // fill with junk
     inc_page_ref((uint64)r);
   }
   return (void*)r;
 }
+
+// add the allocator's counters to ks.
+void
+kallocstat(struct kstat *ks)
+{
+  for(int i = 0; i < NCPU; i++){
+    ks->nalloclocal += kmems[i].nlocal;
+    ks->nallocremote += kmems[i].nremote;
+    ks->nkalloc += kmems[i].nlocal + kmems[i].nremote;
+    ks->nkfree += kmems[i].nfree;
+    ks->nsteal += kmems[i].nsteal;
+  }
+}
+
+// fill in the allocator's part of mi. the free counts are
+// read without locks, so they are only a snapshot.
+void
+kallocinfo(struct meminfo *mi)
+{
+  uint64 pa;
+
+  mi->total = npages;
+  for(int i = 0; i < NCPU; i++){
+    mi->cpufree[i] = kmems[i].size;
+    mi->free += kmems[i].size;
+  }
+  for(int i = 0; i < NNUMA; i++){
+    mi->nodefree[i] = knodes[i].size;
+    mi->free += knodes[i].size;
+  }
+  for(pa = (uint64)freestart; pa < phystop; pa += PGSIZE)
+    if(page_ref_count[PA2INDEX(pa)] > 1)
+      mi->cowshared++;
+}
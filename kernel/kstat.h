@@ -0,0 +1,56 @@
+// kernel event counters, as returned by the kstat system call.
+// each is a total over all cpus since boot.
+struct kstat {
+  uint64 nswtch;       // context switches away from a process
+  uint64 nbread;       // bread() calls
+  uint64 nsleepspin;   // contended acquiresleep()s that only spun
+  uint64 nsleepblock;  // contended acquiresleep()s that slept
+  uint64 nalloclocal;  // kalloc()s served from the caller's NUMA node
+  uint64 nallocremote; // kalloc()s served from another node
+  uint64 nkalloc;      // pages allocated
+  uint64 nkfree;       // pages freed (last reference dropped)
+  uint64 nsteal;       // page batches taken from another cpu's cache
+  uint64 nlazyfault;   // page faults that allocated a lazy page
+  uint64 ncowfault;    // page faults that broke copy-on-write sharing
+  uint64 ntracedrop;   // system call trace records lost to a full buffer
+  uint64 ndiskread;    // blocks read from a disk, the RAM disk included
+  uint64 ndiskwrite;   // blocks written to a disk
+};
+
+// physical memory usage, as returned by the meminfo system
+// call, in pages. needs param.h.
+struct meminfo {
+  uint64 total;          // pages managed by kalloc()
+  uint64 free;           // pages on all free lists
+  uint64 cpufree[NCPU];  // free pages in each cpu's cache
+  uint64 nodefree[NNUMA];// free pages on each NUMA node's list
+  uint64 cowshared;      // allocated pages mapped by more than one page table
+  uint64 ptpages;        // page-table pages, kernel and user
+  uint64 bufpages;       // buffer cache
+};
+
+// a process's memory, as returned by the procmem system call.
+// counts are in pages. once a page is shared with another
+// process, copy-on-write or read-only, it counts as shared;
+// the rest of the resident pages are private.
+#define PM_TEXT  0  // program text and data
+#define PM_STACK 1
+#define PM_HEAP  2
+#define NPMREGION 3
+
+struct pmregion {
+  uint64 start, end;   // virtual address range
+  uint64 resident;     // pages mapped
+  uint64 shared;       // resident pages also mapped elsewhere
+  uint64 cow;          // resident pages marked copy-on-write
+  uint64 huge;         // mappings larger than a page
+};
+
+struct procmem {
+  int pid;
+  char name[16];
+  uint64 sz;               // bytes of address space
+  uint64 stackpeak;        // bytes of stack touched so far
+  uint64 ptpages;          // page-table pages
+  struct pmregion region[NPMREGION];
+};
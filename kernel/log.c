@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "fcntl.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -29,6 +30,12 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// In ordered mode (log_datamode(DATA_ORDERED)) writei() writes
+// the data of regular files straight to its home location, so
+// only the metadata goes through the log; since the data is
+// written before the operation ends, it is on disk before the
+// transaction that points the file at it commits.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -44,6 +51,9 @@ struct log {
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
   int dev;
+  int ordered;     // DATA_ORDERED: file data bypasses the log
+  int nfree;       // blocks freed by the running transaction
+  uint ncommit;    // transactions committed so far
   struct logheader lh;
 };
 struct log log;
@@ -57,9 +67,15 @@ initlog(int dev, struct superblock *sb)
   if (sizeof(struct logheader) >= BSIZE)
     panic("initlog: too big logheader");
 
+  // mkfs may size the log: it holds log.size-1 blocks after
+  // the header, but no more than LOGSIZE, since the header and
+  // the buffer cache have room for only that many.
+  if (sb->nlog - 1 < MAXOPBLOCKS)
+    panic("initlog: log too small");
+
   initlock(&log.lock, "log");
   log.start = sb->logstart;
-  log.size = sb->nlog;
+  log.size = sb->nlog - 1 < LOGSIZE ? sb->nlog : LOGSIZE + 1;
   log.dev = dev;
   recover_from_log();
 }
@@ -130,7 +146,7 @@ begin_op(void)
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > log.size - 1){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
@@ -169,6 +185,8 @@ end_op(void)
     commit();
     acquire(&log.lock);
     log.committing = 0;
+    log.nfree = 0;
+    log.ncommit++;
     wakeup(&log);
     release(&log.lock);
   }
@@ -216,8 +234,14 @@ log_write(struct buf *b)
 {
   int i;
 
+  // file systems without a log (the RAM disk) are written through.
+  if (b->dev != log.dev) {
+    bwrite(b);
+    return;
+  }
+
   acquire(&log.lock);
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.lh.n >= log.size - 1)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
@@ -234,3 +258,66 @@ log_write(struct buf *b)
   release(&log.lock);
 }
 
+
+// May a file data block just allocated on dev, or owned by a
+// locked inode, be written straight to its home location
+// rather than through the log? Only in ordered mode, and only
+// if the running transaction has freed no blocks: the block
+// might be one of them, and a crash before the commit would
+// leave the old owner pointing at the new data.
+int
+log_direct(uint dev)
+{
+  int r;
+
+  if (dev != log.dev)
+    return 1;
+  acquire(&log.lock);
+  r = log.ordered && log.nfree == 0;
+  release(&log.lock);
+  return r;
+}
+
+// Note that the running transaction has freed a block of dev.
+void
+log_free(uint dev)
+{
+  if (dev != log.dev)
+    return;
+  acquire(&log.lock);
+  log.nfree++;
+  release(&log.lock);
+}
+
+// Wait until the operations that have ended so far are on
+// disk. Must not be called inside a transaction.
+void
+log_sync(void)
+{
+  uint target;
+
+  acquire(&log.lock);
+  if (log.lh.n > 0 || log.committing) {
+    // the running or committing transaction holds them.
+    target = log.ncommit + 1;
+    while (log.ncommit < target)
+      sleep(&log, &log.lock);
+  }
+  release(&log.lock);
+}
+
+// Set the data mode to DATA_JOURNAL or DATA_ORDERED; return
+// the old one, or -1 if mode is neither.
+int
+log_datamode(int mode)
+{
+  int old;
+
+  if (mode != DATA_JOURNAL && mode != DATA_ORDERED)
+    return -1;
+  acquire(&log.lock);
+  old = log.ordered ? DATA_ORDERED : DATA_JOURNAL;
+  log.ordered = mode == DATA_ORDERED;
+  release(&log.lock);
+  return old;
+}
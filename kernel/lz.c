@@ -0,0 +1,153 @@
+//
+// A small LZ77 codec in the style of LZ4's block format, for
+// compressed files (see fs.c).
+//
+// the compressed data is a run of sequences, each a token byte,
+// literals, and a match: the token's high nibble is the number
+// of literals and its low nibble the match length less
+// LZMINMATCH, either continued in following bytes when it is 15
+// (each byte added, until one is below 255). the literals
+// follow, then the match's distance back in the output, two
+// bytes little-endian. the last sequence has only literals.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define LZMINMATCH 4
+#define LZHASHBITS 11  // a page of ushort offsets
+#define LZMAXDIST  65535
+
+static uint
+lzhash(uchar *p)
+{
+  uint v = p[0] | p[1] << 8 | p[2] << 16 | (uint)p[3] << 24;
+  return (v * 2654435761U) >> (32 - LZHASHBITS);
+}
+
+// Append length n, past the nibble's 15, to dst at *op.
+static int
+lzlen(uchar *dst, int *op, int max, uint n)
+{
+  for(; n >= 255; n -= 255){
+    if(*op >= max)
+      return -1;
+    dst[(*op)++] = 255;
+  }
+  if(*op >= max)
+    return -1;
+  dst[(*op)++] = n;
+  return 0;
+}
+
+// Append a sequence of nlit literals and, if mlen is not 0, a
+// match of mlen bytes dist back.
+static int
+lzseq(uchar *dst, int *op, int max, uchar *lit, uint nlit, uint dist, uint mlen)
+{
+  uint ml = mlen ? mlen - LZMINMATCH : 0;
+
+  if(*op >= max)
+    return -1;
+  dst[(*op)++] = (nlit < 15 ? nlit : 15) << 4 | (ml < 15 ? ml : 15);
+  if(nlit >= 15 && lzlen(dst, op, max, nlit - 15) < 0)
+    return -1;
+  if(*op + nlit > max)
+    return -1;
+  memmove(dst + *op, lit, nlit);
+  *op += nlit;
+  if(mlen == 0)
+    return 0;
+  if(*op + 2 > max)
+    return -1;
+  dst[(*op)++] = dist;
+  dst[(*op)++] = dist >> 8;
+  if(ml >= 15 && lzlen(dst, op, max, ml - 15) < 0)
+    return -1;
+  return 0;
+}
+
+// Compress the n bytes at src into dst, which has room for max,
+// using tab, a page, for scratch. Returns the compressed
+// length, or -1 if it would exceed max.
+int
+lzcompress(uchar *src, int n, uchar *dst, int max, void *tab)
+{
+  ushort *pos = tab;  // last offset + 1 of each hash
+  int ip = 0, anchor = 0, op = 0, ref, len;
+  uint h;
+
+  memset(tab, 0, (1 << LZHASHBITS) * sizeof(ushort));
+  while(ip + LZMINMATCH <= n){
+    h = lzhash(src + ip);
+    ref = pos[h] - 1;
+    pos[h] = ip + 1;
+    if(ref < 0 || ip - ref > LZMAXDIST || memcmp(src + ref, src + ip, LZMINMATCH) != 0){
+      ip++;
+      continue;
+    }
+    for(len = LZMINMATCH; ip + len < n && src[ref + len] == src[ip + len]; len++)
+      ;
+    if(lzseq(dst, &op, max, src + anchor, ip - anchor, ip - ref, len) < 0)
+      return -1;
+    ip += len;
+    anchor = ip;
+  }
+  if(lzseq(dst, &op, max, src + anchor, n - anchor, 0, 0) < 0)
+    return -1;
+  return op;
+}
+
+// Read a length continued past the nibble's 15.
+static int
+lzgetlen(uchar *src, int *ip, int n, uint *len)
+{
+  uint b;
+
+  do {
+    if(*ip >= n)
+      return -1;
+    b = src[(*ip)++];
+    *len += b;
+  } while(b == 255);
+  return 0;
+}
+
+// Decompress the n bytes at src into dst, which has room for
+// max. Returns the decompressed length, or -1 if the data is
+// not valid.
+int
+lzdecompress(uchar *src, int n, uchar *dst, int max)
+{
+  int ip = 0, op = 0;
+  uint tok, nlit, mlen, dist;
+
+  while(ip < n){
+    tok = src[ip++];
+    nlit = tok >> 4;
+    if(nlit == 15 && lzgetlen(src, &ip, n, &nlit) < 0)
+      return -1;
+    if(ip + nlit > n || op + nlit > max)
+      return -1;
+    memmove(dst + op, src + ip, nlit);
+    ip += nlit;
+    op += nlit;
+    if(ip == n)
+      break;  // the last sequence
+    if(ip + 2 > n)
+      return -1;
+    dist = src[ip] | src[ip+1] << 8;
+    ip += 2;
+    mlen = tok & 0xF;
+    if(mlen == 15 && lzgetlen(src, &ip, n, &mlen) < 0)
+      return -1;
+    mlen += LZMINMATCH;
+    if(dist == 0 || dist > op || op + mlen > max)
+      return -1;
+    // byte by byte: the match may overlap its own output.
+    for(; mlen > 0; mlen--, op++)
+      dst[op] = dst[op - dist];
+  }
+  return op;
+}
@@ -16,9 +16,12 @@ main()
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
+    numainit();      // memory and NUMA layout, from the device tree
     kinit();         // physical page allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    rcuinit();       // read-copy update
+    traceinit();     // system call tracing
     procinit();      // process table
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
@@ -27,7 +30,9 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
-    virtio_disk_init(); // emulated hard disk
+    virtio_disk_init(); // emulated hard disks
+    stripeinit();    // RAID-0 over the disks
+    ramdiskinit();   // RAM disk
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
@@ -8,6 +8,7 @@
 // 0C000000 -- PLIC
 // 10000000 -- uart0 
 // 10001000 -- virtio disk 
+// 10002000 -- more virtio-mmio slots, one page each, up to 10008000
 // 80000000 -- boot ROM jumps here in machine mode
 //             -kernel loads the kernel here
 // unused RAM after 80000000.
@@ -15,7 +16,7 @@
 // the kernel uses physical memory thus:
 // 80000000 -- entry.S, then kernel text and data
 // end -- start of kernel page allocation area
-// PHYSTOP -- end RAM used by the kernel
+// phystop -- end RAM used by the kernel
 
 // qemu puts UART registers here in physical memory.
 #define UART0 0x10000000L
@@ -24,11 +25,15 @@
 // virtio mmio interface
 #define VIRTIO0 0x10001000
 #define VIRTIO0_IRQ 1
+#define NVIRTIO 8
+#define VIRTIO(n) (VIRTIO0 + (n)*0x1000)
+#define VIRTIO_IRQ(n) (VIRTIO0_IRQ + (n))
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIMEFREQ 10000000           // qemu's mtime cycles per second
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -40,10 +45,15 @@
 #define PLIC_SPRIORITY(hart) (PLIC + 0x201000 + (hart)*0x2000)
 #define PLIC_MCLAIM(hart) (PLIC + 0x200004 + (hart)*0x2000)
 #define PLIC_SCLAIM(hart) (PLIC + 0x201004 + (hart)*0x2000)
+#define NIRQ 32          // IRQs the kernel can route (one enable word).
+#define IRQ_SUBMITTER 0  // affinity: the hart that submitted the request.
 
 // the kernel expects there to be RAM
 // for use by the kernel and user pages
 // from physical address 0x80000000 to PHYSTOP.
+// the kernel itself uses phystop, the end of RAM
+// as described by the device tree, and falls back
+// to PHYSTOP only if there is no device tree.
 #define KERNBASE 0x80000000L
 #define PHYSTOP (KERNBASE + 128*1024*1024)
 
@@ -0,0 +1,11 @@
+// madvise() advice
+#define MADV_NORMAL     0  // no special treatment
+#define MADV_SEQUENTIAL 2  // expect sequential access: fault around
+#define MADV_WILLNEED   3  // map the range's lazy pages now
+#define MADV_DONTNEED   4  // free the range's pages; they refault as zero
+
+// mprotect() protections
+#define PROT_NONE  0
+#define PROT_READ  1
+#define PROT_WRITE 2  // implies PROT_READ
+#define PROT_EXEC  4
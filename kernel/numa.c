@@ -0,0 +1,217 @@
+//
+// NUMA topology: which physical memory and which harts belong
+// to which node. read at boot from the flattened device tree
+// that qemu passes in a1; "make qemu NUMA=2" asks qemu for
+// two nodes. without NUMA information everything is node 0,
+// and without a usable device tree RAM is KERNBASE..PHYSTOP.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define FDT_MAGIC      0xd00dfeed
+#define FDT_BEGIN_NODE 1
+#define FDT_END_NODE   2
+#define FDT_PROP       3
+#define FDT_NOP        4
+#define FDT_END        9
+
+#define NMEMRANGE 8
+
+extern uint64 dtb;  // start.c
+
+uint64 phystop;     // end of RAM
+
+static struct memrange {
+  uint64 start;
+  uint64 end;
+  int node;
+} memrange[NMEMRANGE];
+static int nmemrange;
+static int nnode = 1;
+static int hartnode[NCPU];
+
+// device tree values are big-endian.
+static uint32
+be32(uchar *p)
+{
+  return ((uint32)p[0] << 24) | ((uint32)p[1] << 16) |
+         ((uint32)p[2] << 8) | p[3];
+}
+
+static uint64
+becells(uchar *p, int ncells)
+{
+  uint64 v = 0;
+
+  for(int i = 0; i < ncells; i++)
+    v = (v << 32) | be32(p + 4*i);
+  return v;
+}
+
+// is name "prefix" or "prefix@unit-address"?
+static int
+nodeis(char *name, char *prefix)
+{
+  int n = strlen(prefix);
+
+  return strncmp(name, prefix, n) == 0 && (name[n] == 0 || name[n] == '@');
+}
+
+static int
+propis(char *name, char *s)
+{
+  return strncmp(name, s, strlen(s) + 1) == 0;
+}
+
+static void
+addrange(uint64 start, uint64 end)
+{
+  if(end <= KERNBASE || nmemrange == NMEMRANGE)
+    return;
+  if(start < KERNBASE)
+    start = KERNBASE;
+  memrange[nmemrange].start = start;
+  memrange[nmemrange].end = end;
+  memrange[nmemrange].node = 0;
+  nmemrange++;
+}
+
+#define MAXDEPTH 8
+
+// walk the device tree's structure block, collecting the
+// memory nodes' ranges and the memory and cpu nodes' node ids.
+// returns 0, or -1 if there is no usable device tree.
+static int
+parsefdt(uchar *fdt)
+{
+  uchar *p, *end, *strs, *val;
+  char *name;
+  int depth = 0, len, acells = 2, scells = 2, cpucells = 1;
+  // per open node: name, first memory range, numa-node-id, hart.
+  char *node[MAXDEPTH];
+  int first[MAXDEPTH], id[MAXDEPTH], hart[MAXDEPTH];
+
+  if(fdt == 0 || be32(fdt) != FDT_MAGIC)
+    return -1;
+  p = fdt + be32(fdt + 8);
+  end = fdt + be32(fdt + 4);
+  strs = fdt + be32(fdt + 12);
+
+  while(p < end){
+    uint32 tok = be32(p);
+    p += 4;
+    if(tok == FDT_BEGIN_NODE){
+      if(++depth >= MAXDEPTH)
+        return -1;
+      node[depth] = (char*)p;
+      first[depth] = nmemrange;
+      id[depth] = -1;
+      hart[depth] = -1;
+      p += (strlen(node[depth]) + 1 + 3) & ~3;
+    } else if(tok == FDT_END_NODE){
+      if(depth < 1)
+        return -1;
+      if(id[depth] >= 0){
+        if(depth == 2 && nodeis(node[2], "memory")){
+          for(int i = first[depth]; i < nmemrange; i++)
+            memrange[i].node = id[depth];
+        }
+        if(depth == 3 && nodeis(node[2], "cpus") && hart[depth] >= 0 && hart[depth] < NCPU)
+          hartnode[hart[depth]] = id[depth];
+        if(id[depth] >= nnode)
+          nnode = id[depth] + 1;
+      }
+      depth--;
+    } else if(tok == FDT_PROP){
+      if(depth < 1)
+        return -1;
+      len = be32(p);
+      name = (char*)strs + be32(p + 4);
+      val = p + 8;
+      p += 8 + ((len + 3) & ~3);
+      if(depth == 1 && propis(name, "#address-cells"))
+        acells = be32(val);
+      else if(depth == 1 && propis(name, "#size-cells"))
+        scells = be32(val);
+      else if(depth == 2 && nodeis(node[2], "cpus") && propis(name, "#address-cells"))
+        cpucells = be32(val);
+      else if(propis(name, "numa-node-id") && len == 4)
+        id[depth] = be32(val);
+      else if(depth == 2 && nodeis(node[2], "memory") && propis(name, "reg")){
+        int n = 4 * (acells + scells);
+        for(int off = 0; off + n <= len; off += n){
+          uint64 base = becells(val + off, acells);
+          addrange(base, base + becells(val + off + 4*acells, scells));
+        }
+      } else if(depth == 3 && nodeis(node[2], "cpus") && nodeis(node[3], "cpu") &&
+                propis(name, "reg"))
+        hart[depth] = becells(val, cpucells);
+    } else if(tok != FDT_NOP){
+      break;  // FDT_END, or garbage.
+    }
+  }
+  return nmemrange > 0 ? 0 : -1;
+}
+
+// read the topology; must run before kinit().
+void
+numainit(void)
+{
+  if(parsefdt((uchar*)dtb) < 0){
+    nmemrange = 0;
+    nnode = 1;
+    memset(hartnode, 0, sizeof(hartnode));
+    addrange(KERNBASE, PHYSTOP);
+  }
+  if(nnode > NNUMA)
+    panic("numainit: too many nodes");
+
+  phystop = 0;
+  for(int i = 0; i < nmemrange; i++)
+    if(memrange[i].end > phystop)
+      phystop = memrange[i].end;
+
+  if(nnode > 1){
+    for(int i = 0; i < nmemrange; i++)
+      printf("numa: node %d memory %p-%p\n", memrange[i].node,
+             memrange[i].start, memrange[i].end);
+  }
+}
+
+int
+numanodes(void)
+{
+  return nnode;
+}
+
+// node that hart belongs to.
+int
+cpunode(int hart)
+{
+  return hartnode[hart];
+}
+
+// node that holds physical address pa.
+int
+pa2node(uint64 pa)
+{
+  for(int i = 0; i < nmemrange; i++)
+    if(pa >= memrange[i].start && pa < memrange[i].end)
+      return memrange[i].node;
+  return 0;
+}
+
+// the i'th range of RAM, for kinit(). returns 0 if there is none.
+int
+memrangeget(int i, uint64 *start, uint64 *end)
+{
+  if(i >= nmemrange)
+    return 0;
+  *start = memrange[i].start;
+  *end = memrange[i].end;
+  return 1;
+}
@@ -1,13 +1,25 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define NNUMA         4  // maximum number of NUMA nodes
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
+#define RAMDEV        2  // device number of the RAM disk
+#define NMOUNT        4  // maximum number of mounted file systems
 #define MAXARG       32  // max exec arguments
+#define MAXARGPAGES   4  // max pages of exec argument strings
+#define USTACKSIZE (8*1024*1024)  // user stack address space, grown on demand
+#define SLEEPSPIN  10000  // acquiresleep() spin limit before sleeping
+#define FAULTAROUND  16  // pages mapped per fault in MADV_SEQUENTIAL regions
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define NCCACHE       8  // decompressed clusters of compressed files cached
 #define FSSIZE       2000  // size of file system in blocks
+#define STRIPEBLOCKS    4  // blocks per RAID-0 stripe unit
+#define RAMDISKSIZE  4096  // size of the RAM disk in blocks
+#define RAMDISKINODES 200  // inodes on a freshly formatted RAM disk
+#define NTRACE      512  // system call trace records buffered
 #define MAXPATH      128   // maximum file path name
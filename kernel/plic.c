@@ -2,28 +2,84 @@
 #include "param.h"
 #include "memlayout.h"
 #include "riscv.h"
+#include "spinlock.h"
 #include "defs.h"
 
 //
 // the riscv Platform Level Interrupt Controller (PLIC).
 //
+// each device IRQ is enabled only on the harts in its affinity
+// mask (all harts by default). an IRQ whose affinity is
+// IRQ_SUBMITTER follows the hart that last submitted a request
+// to the device: the driver calls plic_steer() before starting
+// each request, so the completion interrupt lands on the hart
+// whose caches hold the request and the waiting process.
+//
+
+static struct spinlock plic_lock; // protects the routing state below.
+static uint32 affinity[NIRQ];     // hart mask, or IRQ_SUBMITTER.
+static int target[NIRQ];          // IRQ_SUBMITTER: hart to deliver to, or -1.
+static char routed[NIRQ];         // is this a device IRQ the kernel handles?
+static uint32 started;            // harts that have run plicinithart().
+
+// interrupts claimed, per hart and IRQ.
+static uint64 intrcount[NCPU][NIRQ];
+
+static void
+route(int irq)
+{
+  *(uint32*)(PLIC + irq*4) = 1;  // non-zero priority (otherwise disabled).
+  routed[irq] = 1;
+  affinity[irq] = (1 << NCPU) - 1;
+  target[irq] = -1;
+}
 
 void
 plicinit(void)
 {
+  initlock(&plic_lock, "plic");
+
   // set desired IRQ priorities non-zero (otherwise disabled).
-  *(uint32*)(PLIC + UART0_IRQ*4) = 1;
-  *(uint32*)(PLIC + VIRTIO0_IRQ*4) = 1;
+  route(UART0_IRQ);
+  for(int i = 0; i < NVIRTIO; i++)
+    route(VIRTIO_IRQ(i));
+}
+
+// is irq enabled on hart?
+static int
+enabled(int irq, int hart)
+{
+  if(!routed[irq])
+    return 0;
+  if(affinity[irq] == IRQ_SUBMITTER)
+    return target[irq] < 0 || target[irq] == hart;
+  return (affinity[irq] >> hart) & 1;
+}
+
+// write hart's S-mode enable bits from the routing state.
+// caller must hold plic_lock.
+static void
+setenable(int hart)
+{
+  uint32 enable = 0;
+
+  for(int irq = 1; irq < NIRQ; irq++)
+    if(enabled(irq, hart))
+      enable |= 1 << irq;
+  *(uint32*)PLIC_SENABLE(hart) = enable;
 }
 
 void
 plicinithart(void)
 {
   int hart = cpuid();
-  
+
   // set enable bits for this hart's S-mode
-  // for the uart and virtio disk.
-  *(uint32*)PLIC_SENABLE(hart) = (1 << UART0_IRQ) | (1 << VIRTIO0_IRQ);
+  // for the uart and virtio disks.
+  acquire(&plic_lock);
+  started |= 1 << hart;
+  setenable(hart);
+  release(&plic_lock);
 
   // set this hart's S-mode priority threshold to 0.
   *(uint32*)PLIC_SPRIORITY(hart) = 0;
@@ -35,6 +91,8 @@ plic_claim(void)
 {
   int hart = cpuid();
   int irq = *(uint32*)PLIC_SCLAIM(hart);
+  if(irq > 0 && irq < NIRQ)
+    intrcount[hart][irq]++;
   return irq;
 }
 
@@ -45,3 +103,65 @@ plic_complete(int irq)
   int hart = cpuid();
   *(uint32*)PLIC_SCLAIM(hart) = irq;
 }
+
+// if irq follows the submitting hart, deliver it to this one.
+// called by drivers, with interrupts off, before they start
+// a request.
+void
+plic_steer(int irq)
+{
+  int hart = cpuid();
+  int old;
+
+  // unlocked peek: the common case is that nothing changes.
+  if(affinity[irq] != IRQ_SUBMITTER || target[irq] == hart)
+    return;
+
+  acquire(&plic_lock);
+  if(affinity[irq] == IRQ_SUBMITTER && target[irq] != hart){
+    old = target[irq];
+    target[irq] = hart;
+    if(old < 0){
+      for(int h = 0; h < NCPU; h++)
+        if(started & (1 << h))
+          setenable(h);
+    } else {
+      setenable(old);
+      setenable(hart);
+    }
+  }
+  release(&plic_lock);
+}
+
+// route irq to the harts in mask, or to the submitting hart
+// if mask is IRQ_SUBMITTER. returns 0, or -1 if irq is not a
+// device IRQ or mask names no running hart.
+int
+plic_setaffinity(int irq, uint32 mask)
+{
+  if(irq <= 0 || irq >= NIRQ || !routed[irq])
+    return -1;
+  if(mask != IRQ_SUBMITTER && (mask & started) == 0)
+    return -1;
+
+  acquire(&plic_lock);
+  affinity[irq] = mask;
+  target[irq] = -1;
+  for(int h = 0; h < NCPU; h++)
+    if(started & (1 << h))
+      setenable(h);
+  release(&plic_lock);
+  return 0;
+}
+
+// copy irq's per-hart interrupt counts to counts[0..NCPU-1].
+// returns irq's affinity mask, or -1 if irq is not a device IRQ.
+int
+plic_stat(int irq, uint64 *counts)
+{
+  if(irq <= 0 || irq >= NIRQ || !routed[irq])
+    return -1;
+  for(int h = 0; h < NCPU; h++)
+    counts[h] = intrcount[h][irq];
+  return affinity[irq];
+}
@@ -4,7 +4,9 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "rcu.h"
 #include "defs.h"
+#include "kstat.h"
 
 struct cpu cpus[NCPU];
 
@@ -16,10 +18,32 @@ int nextpid = 1;
 struct spinlock pid_lock;
 
 extern void forkret(void);
+static void kthreadret(void);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// pid -> proc hash table, read lock-free under RCU.
+// entries come from a fixed pool, and go back to it only
+// after a grace period, so a reader never sees an entry
+// reused while it is looking at it.
+#define NPIDHASH 64
+
+struct pident {
+  struct rcu_head rcu;   // first, so call_rcu()'s callback can cast.
+  int pid;
+  struct proc *p;
+  struct pident *next;   // next in hash chain
+};
+
+static struct {
+  struct spinlock lock;  // serializes writers
+  struct pident *hash[NPIDHASH];
+  struct pident *free;
+  // twice NPROC, since freed entries wait out a grace period.
+  struct pident ent[2*NPROC];
+} pidtab;
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
@@ -51,6 +75,11 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&pidtab.lock, "pidtab");
+  for(int i = 0; i < NELEM(pidtab.ent); i++){
+    pidtab.ent[i].next = pidtab.free;
+    pidtab.free = &pidtab.ent[i];
+  }
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -102,6 +131,82 @@ allocpid()
   return pid;
 }
 
+// add p to the pid table. returns 0, or -1 if
+// all entries are in use or waiting to be freed.
+static int
+pidinsert(struct proc *p)
+{
+  struct pident *e, **bucket;
+
+  acquire(&pidtab.lock);
+  if((e = pidtab.free) == 0){
+    release(&pidtab.lock);
+    return -1;
+  }
+  pidtab.free = e->next;
+  e->pid = p->pid;
+  e->p = p;
+  bucket = &pidtab.hash[p->pid % NPIDHASH];
+  e->next = *bucket;
+  // publish e only once it is filled in.
+  __atomic_store_n(bucket, e, __ATOMIC_RELEASE);
+  release(&pidtab.lock);
+  return 0;
+}
+
+static void
+pidentfree(struct rcu_head *h)
+{
+  struct pident *e = (struct pident*)h;
+
+  acquire(&pidtab.lock);
+  e->next = pidtab.free;
+  pidtab.free = e;
+  release(&pidtab.lock);
+}
+
+// remove pid from the pid table. readers may still be
+// looking at its entry, so it is freed after a grace period.
+static void
+pidremove(int pid)
+{
+  struct pident *e, **pp;
+
+  acquire(&pidtab.lock);
+  for(pp = &pidtab.hash[pid % NPIDHASH]; (e = *pp) != 0; pp = &e->next){
+    if(e->pid == pid){
+      // e->next stays intact for readers still on e.
+      __atomic_store_n(pp, e->next, __ATOMIC_RELEASE);
+      call_rcu(&e->rcu, pidentfree);
+      break;
+    }
+  }
+  release(&pidtab.lock);
+}
+
+// find the proc with pid, without taking any locks.
+// the answer may be stale by the time it is used: the
+// caller must lock the proc and check that p->pid == pid.
+struct proc*
+pidlookup(int pid)
+{
+  struct pident *e;
+  struct proc *p = 0;
+
+  if(pid <= 0)
+    return 0;
+  rcu_read_lock();
+  e = __atomic_load_n(&pidtab.hash[pid % NPIDHASH], __ATOMIC_ACQUIRE);
+  for(; e; e = __atomic_load_n(&e->next, __ATOMIC_ACQUIRE)){
+    if(e->pid == pid){
+      p = e->p;
+      break;
+    }
+  }
+  rcu_read_unlock();
+  return p;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -125,6 +230,12 @@ found:
   p->pid = allocpid();
   p->state = USED;
 
+  if(pidinsert(p) < 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
     freeproc(p);
@@ -162,6 +273,15 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  p->imgend = 0;
+  p->stackbot = p->stacktop = p->stacklow = 0;
+  p->seqstart = p->seqend = 0;
+  p->segvhandler = 0;
+  p->insegv = 0;
+  p->traced = 0;
+  p->kthread = 0;
+  if(p->pid)
+    pidremove(p->pid);
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -241,6 +361,7 @@ userinit(void)
   // and data into it.
   uvmfirst(p->pagetable, initcode, sizeof(initcode));
   p->sz = PGSIZE;
+  p->imgend = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
@@ -254,6 +375,36 @@ userinit(void)
   release(&p->lock);
 }
 
+// Start a kernel thread that runs fn(), which must not return.
+// It has no user memory and never enters user space.
+// Returns 0, or -1 if there is no free proc.
+int
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    return -1;
+  p->kthread = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+  release(&p->lock);
+  return 0;
+}
+
+// a kernel thread's first scheduling switches here.
+static void
+kthreadret(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+  p->kthread();
+  panic("kthread returned");
+}
+
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -295,6 +446,15 @@ fork(void)
     return -1;
   }
   np->sz = p->sz;
+  np->imgend = p->imgend;
+  np->stackbot = p->stackbot;
+  np->stacktop = p->stacktop;
+  np->stacklow = p->stacklow;
+  np->seqstart = p->seqstart;
+  np->seqend = p->seqend;
+  np->segvhandler = p->segvhandler;
+  np->insegv = p->insegv;
+  np->segvframe = p->segvframe;
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -314,6 +474,9 @@ fork(void)
 
   release(&np->lock);
 
+  if(p->traced > 0)
+    tracefork(np);
+
   acquire(&wait_lock);
   np->parent = p;
   release(&wait_lock);
@@ -351,6 +514,8 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  traceexit();
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -452,6 +617,9 @@ scheduler(void)
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
+    // no RCU read-side section can span a trip through here.
+    rcu_quiescent();
+
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
       if(p->state == RUNNABLE) {
@@ -494,6 +662,7 @@ sched(void)
     panic("sched interruptible");
 
   intena = mycpu()->intena;
+  mycpu()->nswtch++;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
 }
@@ -587,20 +756,96 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->pid != pid){
+    // exited, and perhaps reused, since the lookup.
+    release(&p->lock);
+    return -1;
+  }
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+  }
+  release(&p->lock);
+  return 0;
+}
+
+// fill in pm for process pid. returns 0, or -1 if there
+// is no such process.
+int
+procmem(int pid, struct procmem *pm)
+{
+  struct proc *p;
+
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->pid != pid || p->pagetable == 0){
+    release(&p->lock);
+    return -1;
+  }
+  // the owner changes its page table without p->lock, but
+  // never frees page-table pages while running; exec() swaps
+  // in its new table, and freeproc() frees it, holding p->lock.
+  memset(pm, 0, sizeof(*pm));
+  pm->pid = pid;
+  safestrcpy(pm->name, p->name, sizeof(pm->name));
+  pm->sz = p->sz;
+  if(p->stacktop){
+    pm->stackpeak = p->stacktop - p->stacklow;
+    pm->region[PM_TEXT].end = p->stackbot;
+    pm->region[PM_STACK].start = p->stackbot;
+    pm->region[PM_STACK].end = p->stacktop;
+    pm->region[PM_HEAP].start = p->stacktop;
+  } else {
+    pm->region[PM_TEXT].end = p->sz;  // initcode, before its exec()
+    pm->region[PM_STACK].start = pm->region[PM_STACK].end = p->sz;
+    pm->region[PM_HEAP].start = p->sz;
+  }
+  pm->region[PM_HEAP].end = p->sz;
+  uvmstat(p->pagetable, p->sz, pm);
+  release(&p->lock);
+  return 0;
+}
+
+// reader-scaling benchmark: look up the caller's pid for
+// nticks ticks, with the pid table (rcu != 0) or with the
+// scan of proc[] that kill() used to do. returns the
+// number of lookups, or -1.
+int
+rcubench(int rcu, int nticks)
+{
+  int pid = myproc()->pid;
+  struct proc *p, *found;
+  int n = 0;
+  uint end;
+
+  if(nticks < 0)
+    return -1;
+  end = __atomic_load_n(&ticks, __ATOMIC_RELAXED) + nticks;
+  while((int)(__atomic_load_n(&ticks, __ATOMIC_RELAXED) - end) < 0){
+    found = 0;
+    if(rcu){
+      found = pidlookup(pid);
+    } else {
+      for(p = proc; p < &proc[NPROC]; p++){
+        acquire(&p->lock);
+        if(p->pid == pid){
+          found = p;
+          release(&p->lock);
+          break;
+        }
+        release(&p->lock);
       }
-      release(&p->lock);
-      return 0;
     }
-    release(&p->lock);
+    if(found == 0)
+      return -1;
+    n++;
   }
-  return -1;
+  return n;
 }
 
 void
@@ -678,6 +923,8 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    if(p->stacktop)
+      printf(" stack %dK", (int)((p->stacktop - p->stacklow) / 1024));
     printf("\n");
   }
 }
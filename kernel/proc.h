@@ -24,6 +24,18 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct mcsnode mcs[NMCS];   // Queue nodes for MCS spinlocks.
+
+  // event counters, summed over cpus by sys_kstat().
+  uint64 nswtch;              // sched() calls: a process gave up the cpu
+  uint64 nbread;              // bread() calls
+  uint64 nsleepspin;          // acquiresleep() waits that only spun
+  uint64 nsleepblock;         // acquiresleep() waits that slept
+  uint64 nlazyfault;          // lazy-allocation page faults
+  uint64 ncowfault;           // copy-on-write page faults that copied
+  uint64 ntracedrop;          // trace records dropped, under trace.c's lock
+  uint64 ndiskread;           // blocks read from a disk
+  uint64 ndiskwrite;          // blocks written to a disk
 };
 
 extern struct cpu cpus[NCPU];
@@ -91,6 +103,7 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int traced;                  // recording system calls? see trace.c
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -98,10 +111,18 @@ struct proc {
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
+  uint64 imgend;               // end of the text and data exec loaded
+  uint64 stackbot, stacktop;   // user stack reservation, or 0
+  uint64 stacklow;             // lowest stack page mapped, for peak usage
+  uint64 seqstart, seqend;     // MADV_SEQUENTIAL region, for fault-around
+  uint64 segvhandler;          // sigsegv() handler, or 0
+  int insegv;                  // running the handler?
+  struct trapframe segvframe;  // registers to restore at sigreturn()
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  void (*kthread)(void);       // body of a kernel thread, or 0
   char name[16];               // Process name (debugging)
 };
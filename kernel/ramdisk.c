@@ -1,5 +1,13 @@
 //
-// ramdisk that uses the disk image loaded by qemu -initrd fs.img
+// RAM disk: a block device backed by kalloc()ed pages, for
+// scratch file systems whose contents need never reach the
+// virtio disks. it is device RAMDEV and holds RAMDISKSIZE blocks.
+//
+// pages are allocated on first write, and blocks that have
+// never been written read as zeros, so an unused RAM disk
+// costs no memory. there is no unmount, so the pages are never
+// freed: a mounted RAM disk keeps every page it has written,
+// even after its files are removed, until reboot.
 //
 
 #include "types.h"
@@ -12,34 +20,46 @@
 #include "fs.h"
 #include "buf.h"
 
+#define BPP (PGSIZE / BSIZE)   // blocks per page
+
+static struct {
+  struct spinlock lock;  // protects pages[]
+  char *pages[(RAMDISKSIZE + BPP - 1) / BPP];
+} ramdisk;
+
 void
 ramdiskinit(void)
 {
+  initlock(&ramdisk.lock, "ramdisk");
 }
 
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// read or write b's data from/to the RAM disk.
 void
-ramdiskrw(struct buf *b)
+ramdiskrw(struct buf *b, int write)
 {
+  char *page;
+
   if(!holdingsleep(&b->lock))
     panic("ramdiskrw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("ramdiskrw: nothing to do");
-
-  if(b->blockno >= FSSIZE)
+  if(b->blockno >= RAMDISKSIZE)
     panic("ramdiskrw: blockno too big");
 
-  uint64 diskaddr = b->blockno * BSIZE;
-  char *addr = (char *)RAMDISK + diskaddr;
-
-  if(b->flags & B_DIRTY){
-    // write
-    memmove(addr, b->data, BSIZE);
-    b->flags &= ~B_DIRTY;
-  } else {
-    // read
-    memmove(b->data, addr, BSIZE);
-    b->flags |= B_VALID;
+  acquire(&ramdisk.lock);
+  page = ramdisk.pages[b->blockno / BPP];
+  if(page == 0 && write){
+    if((page = kalloc()) == 0)
+      panic("ramdiskrw: out of memory");
+    memset(page, 0, PGSIZE);
+    ramdisk.pages[b->blockno / BPP] = page;
   }
+  release(&ramdisk.lock);
+
+  // b's sleep-lock keeps anyone else from using this block,
+  // and pages are never freed, so no lock is needed to copy.
+  if(page == 0)
+    memset(b->data, 0, BSIZE);
+  else if(write)
+    memmove(page + (b->blockno % BPP) * BSIZE, b->data, BSIZE);
+  else
+    memmove(b->data, page + (b->blockno % BPP) * BSIZE, BSIZE);
 }
@@ -0,0 +1,120 @@
+//
+// read-copy update, for tables that are read far more often
+// than they change.
+//
+// readers bracket lock-free lookups with rcu_read_lock() and
+// rcu_read_unlock(), which only disable interrupts and so
+// preemption; readers must not sleep. a writer unlinks an
+// object under its own lock, then hands it to call_rcu(),
+// which runs the callback (typically a free) once every
+// reader that might still see the object has finished.
+//
+// a hart in scheduler() cannot be inside a read-side section,
+// so each pass through the scheduler loop is a quiescent state.
+// a grace period is over once every running hart has passed
+// through a quiescent state since the period began.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "rcu.h"
+#include "defs.h"
+
+static struct {
+  struct spinlock lock;
+  uint64 qs[NCPU];        // quiescent states per hart; only that hart writes.
+  uint32 online;          // harts that have reached scheduler().
+  uint64 snap[NCPU];      // qs[] when the current grace period began.
+  struct rcu_head *next;  // callbacks waiting for a grace period to begin.
+  struct rcu_head *wait;  // callbacks waiting for the current one to end.
+  int pending;            // next or wait non-empty; peeked without the lock.
+} rcu;
+
+void
+rcuinit(void)
+{
+  initlock(&rcu.lock, "rcu");
+}
+
+void
+rcu_read_lock(void)
+{
+  push_off();
+}
+
+void
+rcu_read_unlock(void)
+{
+  pop_off();
+}
+
+// run h->func(h) after a grace period.
+void
+call_rcu(struct rcu_head *h, void (*func)(struct rcu_head*))
+{
+  h->func = func;
+  acquire(&rcu.lock);
+  h->next = rcu.next;
+  rcu.next = h;
+  rcu.pending = 1;
+  release(&rcu.lock);
+}
+
+// has every online hart passed a quiescent state
+// since the current grace period began?
+// caller must hold rcu.lock.
+static int
+gpdone(void)
+{
+  for(int i = 0; i < NCPU; i++){
+    if((rcu.online & (1 << i)) &&
+       __atomic_load_n(&rcu.qs[i], __ATOMIC_ACQUIRE) == rcu.snap[i])
+      return 0;
+  }
+  return 1;
+}
+
+// called by scheduler() on each pass, outside any read-side
+// section: note the quiescent state, and if that ends a grace
+// period, run the callbacks that were waiting for it.
+void
+rcu_quiescent(void)
+{
+  struct rcu_head *done = 0, *h;
+  int id;
+
+  push_off();
+  id = cpuid();
+  pop_off();
+
+  __atomic_store_n(&rcu.qs[id], rcu.qs[id] + 1, __ATOMIC_RELEASE);
+  if((rcu.online & (1 << id)) == 0){
+    acquire(&rcu.lock);
+    rcu.online |= 1 << id;
+    release(&rcu.lock);
+  }
+  if(__atomic_load_n(&rcu.pending, __ATOMIC_RELAXED) == 0)
+    return;
+
+  acquire(&rcu.lock);
+  if(rcu.wait && gpdone()){
+    done = rcu.wait;
+    rcu.wait = 0;
+  }
+  if(rcu.wait == 0 && rcu.next){
+    // start a new grace period.
+    rcu.wait = rcu.next;
+    rcu.next = 0;
+    for(int i = 0; i < NCPU; i++)
+      rcu.snap[i] = __atomic_load_n(&rcu.qs[i], __ATOMIC_ACQUIRE);
+  }
+  rcu.pending = rcu.wait != 0;
+  release(&rcu.lock);
+
+  for(; done; done = h){
+    h = done->next;
+    done->func(done);
+  }
+}
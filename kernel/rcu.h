@@ -0,0 +1,6 @@
+// a deferred call queued by call_rcu(), usually embedded
+// in the object the call will free.
+struct rcu_head {
+  struct rcu_head *next;
+  void (*func)(struct rcu_head*);
+};
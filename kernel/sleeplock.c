@@ -15,17 +15,51 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->owner = 0;
+  lk->nwaiters = 0;
   lk->pid = 0;
 }
 
+// is the holder of lk running on some cpu, and so likely
+// to release it soon? a lock-free peek: the answer is only
+// a hint, since the holder may stop running at any moment.
+static int
+ownerrunning(struct sleeplock *lk)
+{
+  struct proc *owner = __atomic_load_n(&lk->owner, __ATOMIC_RELAXED);
+
+  return owner && __atomic_load_n(&owner->state, __ATOMIC_RELAXED) == RUNNING;
+}
+
 void
 acquiresleep(struct sleeplock *lk)
 {
+  int spins;
+
   acquire(&lk->lk);
+  if(lk->locked){
+    // spin for a while, without lk->lk, as long as the holder
+    // is running: it is probably about to release the lock,
+    // and that is cheaper than two context switches.
+    for(spins = 0; spins < SLEEPSPIN && lk->locked && ownerrunning(lk); spins++){
+      release(&lk->lk);
+      while(__atomic_load_n(&lk->locked, __ATOMIC_RELAXED) &&
+            ++spins < SLEEPSPIN && ownerrunning(lk))
+        ;
+      acquire(&lk->lk);
+    }
+    if(lk->locked)
+      mycpu()->nsleepblock++;
+    else
+      mycpu()->nsleepspin++;
+  }
   while (lk->locked) {
+    lk->nwaiters++;
     sleep(lk, &lk->lk);
+    lk->nwaiters--;
   }
   lk->locked = 1;
+  lk->owner = myproc();
   lk->pid = myproc()->pid;
   release(&lk->lk);
 }
@@ -35,8 +69,10 @@ releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
   lk->locked = 0;
+  lk->owner = 0;
   lk->pid = 0;
-  wakeup(lk);
+  if(lk->nwaiters > 0)
+    wakeup(lk);
   release(&lk->lk);
 }
 
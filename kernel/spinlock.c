@@ -9,13 +9,92 @@
 #include "defs.h"
 
 void
-initlock(struct spinlock *lk, char *name)
+initlocktype(struct spinlock *lk, char *name, int type)
 {
+  if(type < 0 || type >= NSPINTYPE)
+    panic("initlocktype");
   lk->name = name;
   lk->locked = 0;
+  lk->type = type;
+  lk->next = 0;
+  lk->serving = 0;
+  lk->tail = 0;
+  lk->holder = 0;
   lk->cpu = 0;
 }
 
+void
+initlock(struct spinlock *lk, char *name)
+{
+  initlocktype(lk, name, SPIN_TAS);
+}
+
+// take a ticket and wait for it to come up.
+static void
+ticket_acquire(struct spinlock *lk)
+{
+  uint t = __sync_fetch_and_add(&lk->next, 1);
+
+  while(__atomic_load_n(&lk->serving, __ATOMIC_ACQUIRE) != t)
+    ;
+}
+
+static void
+ticket_release(struct spinlock *lk)
+{
+  // only the holder writes serving, so a plain
+  // increment followed by a release store is enough.
+  __atomic_store_n(&lk->serving, lk->serving + 1, __ATOMIC_RELEASE);
+}
+
+// join the queue, then spin on our own node until
+// the previous holder hands the lock over.
+static void
+mcs_acquire(struct spinlock *lk)
+{
+  struct cpu *c = mycpu();
+  struct mcsnode *n, *pred;
+
+  for(n = c->mcs; n < &c->mcs[NMCS]; n++)
+    if(!n->used)
+      break;
+  if(n == &c->mcs[NMCS])
+    panic("mcs_acquire: out of nodes");
+  n->used = 1;
+  n->next = 0;
+  n->wait = 1;
+
+  pred = __atomic_exchange_n(&lk->tail, n, __ATOMIC_ACQ_REL);
+  if(pred){
+    __atomic_store_n(&pred->next, n, __ATOMIC_RELEASE);
+    while(__atomic_load_n(&n->wait, __ATOMIC_ACQUIRE))
+      ;
+  }
+  lk->holder = n;
+}
+
+static void
+mcs_release(struct spinlock *lk)
+{
+  struct mcsnode *n = lk->holder;
+  struct mcsnode *next, *expect = n;
+
+  lk->holder = 0;
+  next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE);
+  if(next == 0){
+    // no known successor: try to mark the lock free.
+    if(__atomic_compare_exchange_n(&lk->tail, &expect, 0, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      goto done;
+    // a waiter is between its exchange and linking itself in.
+    while((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0)
+      ;
+  }
+  __atomic_store_n(&next->wait, 0, __ATOMIC_RELEASE);
+ done:
+  n->used = 0;
+}
+
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
 void
@@ -25,12 +104,20 @@ acquire(struct spinlock *lk)
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(lk->type == SPIN_TICKET){
+    ticket_acquire(lk);
+    lk->locked = 1;
+  } else if(lk->type == SPIN_MCS){
+    mcs_acquire(lk);
+    lk->locked = 1;
+  } else {
+    // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+    //   a5 = 1
+    //   s1 = &lk->locked
+    //   amoswap.w.aq a5, a5, (s1)
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      ;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -66,7 +153,13 @@ release(struct spinlock *lk)
   // On RISC-V, sync_lock_release turns into an atomic swap:
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
+  // For ticket and MCS locks, locked only records that the lock
+  // is held; the hand-off to the next waiter follows.
   __sync_lock_release(&lk->locked);
+  if(lk->type == SPIN_TICKET)
+    ticket_release(lk);
+  else if(lk->type == SPIN_MCS)
+    mcs_release(lk);
 
   pop_off();
 }
@@ -108,3 +201,35 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// lock-scaling benchmark: for nticks clock ticks, repeatedly
+// acquire a shared lock of the given type and update the data
+// it protects. returns the number of acquisitions, or -1.
+static struct spinlock benchlock[NSPINTYPE] = {
+  { .type = SPIN_TAS, .name = "bench tas" },
+  { .type = SPIN_TICKET, .name = "bench ticket" },
+  { .type = SPIN_MCS, .name = "bench mcs" },
+};
+static uint64 benchdata[8];
+
+int
+lockbench(int type, int nticks)
+{
+  struct spinlock *lk;
+  int n = 0;
+  uint end;
+
+  if(type < 0 || type >= NSPINTYPE || nticks < 0)
+    return -1;
+  lk = &benchlock[type];
+
+  end = __atomic_load_n(&ticks, __ATOMIC_RELAXED) + nticks;
+  while((int)(__atomic_load_n(&ticks, __ATOMIC_RELAXED) - end) < 0){
+    acquire(lk);
+    for(int i = 0; i < NELEM(benchdata); i++)
+      benchdata[i]++;
+    release(lk);
+    n++;
+  }
+  return n;
+}
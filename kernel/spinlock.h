@@ -1,9 +1,35 @@
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+  int type;          // SPIN_TAS, SPIN_TICKET or SPIN_MCS
+
+  // SPIN_TICKET: take a ticket, wait until it is served.
+  uint next;         // Next ticket to hand out.
+  uint serving;      // Ticket that holds the lock.
+
+  // SPIN_MCS: each waiter spins on its own queue node.
+  struct mcsnode *tail;    // Last waiter, or 0 if free.
+  struct mcsnode *holder;  // The holder's node.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
 };
 
+// lock types, chosen with initlocktype().
+#define SPIN_TAS     0  // test-and-set: cheap, but unfair under contention
+#define SPIN_TICKET  1  // FIFO, waiters spin on one shared word
+#define SPIN_MCS     2  // FIFO, each waiter spins on its own node
+#define NSPINTYPE    3
+
+// MCS queue node. a cpu needs one for each MCS lock it
+// holds or waits for. only bcache.lock is MCS today, and
+// acquire() runs with interrupts off, so one is in use at a
+// time; the spares let more locks become MCS and nest.
+struct mcsnode {
+  struct mcsnode *next;  // next waiter in the queue
+  int wait;              // spin while non-zero
+  int used;              // node is in a queue
+};
+
+#define NMCS 4
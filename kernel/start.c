@@ -6,6 +6,7 @@
 
 void main();
 void timerinit();
+void start(uint64, uint64);
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
@@ -16,10 +17,17 @@ uint64 timer_scratch[NCPU][5];
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
 
+// physical address of the flattened device tree that
+// qemu passes in a1, for numainit().
+uint64 dtb;
+
 // entry.S jumps here in machine mode on stack0.
 void
-start()
+start(uint64 hartid, uint64 fdt)
 {
+  // every hart is handed the same tree.
+  dtb = fdt;
+
   // set M Previous Privilege mode to Supervisor, for mret.
   unsigned long x = r_mstatus();
   x &= ~MSTATUS_MPP_MASK;
@@ -43,6 +51,9 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the time CSR, for uptimeus().
+  w_mcounteren(r_mcounteren() | 2);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -0,0 +1,39 @@
+//
+// RAID-0 block device: stripes the blocks of one logical disk
+// across all the virtio disks found at boot.
+//
+// logical blocks are grouped into stripe units of STRIPEBLOCKS
+// consecutive blocks, and the units are dealt out to the disks
+// round-robin: unit u lives on disk u % ndisk, as that disk's
+// unit u / ndisk. with a single disk the mapping is the identity.
+// mkfs/stripe splits an fs.img into member images the same way.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+static int ndisk;
+
+void
+stripeinit(void)
+{
+  ndisk = virtio_disk_count();
+  if(ndisk > 1)
+    printf("stripe: %d disks, %d blocks per unit\n", ndisk, STRIPEBLOCKS);
+}
+
+// read or write b through the disk that holds b->blockno.
+void
+striperw(struct buf *b, int write)
+{
+  uint unit = b->blockno / STRIPEBLOCKS;
+  uint off = b->blockno % STRIPEBLOCKS;
+
+  virtio_disk_rw(unit % ndisk, b, (unit / ndisk) * STRIPEBLOCKS + off, write);
+}
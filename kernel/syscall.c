@@ -101,6 +101,25 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_mount(void);
+extern uint64 sys_irqaffinity(void);
+extern uint64 sys_irqstat(void);
+extern uint64 sys_lockbench(void);
+extern uint64 sys_kstat(void);
+extern uint64 sys_rcubench(void);
+extern uint64 sys_meminfo(void);
+extern uint64 sys_madvise(void);
+extern uint64 sys_mprotect(void);
+extern uint64 sys_sigsegv(void);
+extern uint64 sys_sigreturn(void);
+extern uint64 sys_procmem(void);
+extern uint64 sys_uptimeus(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_tracedump(void);
+extern uint64 sys_fsync(void);
+extern uint64 sys_datamode(void);
+extern uint64 sys_clone(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -126,6 +145,25 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_lseek]   sys_lseek,
+[SYS_mount]   sys_mount,
+[SYS_irqaffinity] sys_irqaffinity,
+[SYS_irqstat] sys_irqstat,
+[SYS_lockbench] sys_lockbench,
+[SYS_kstat]   sys_kstat,
+[SYS_rcubench] sys_rcubench,
+[SYS_meminfo] sys_meminfo,
+[SYS_madvise] sys_madvise,
+[SYS_mprotect] sys_mprotect,
+[SYS_sigsegv] sys_sigsegv,
+[SYS_sigreturn] sys_sigreturn,
+[SYS_procmem] sys_procmem,
+[SYS_uptimeus] sys_uptimeus,
+[SYS_trace]   sys_trace,
+[SYS_tracedump] sys_tracedump,
+[SYS_fsync]   sys_fsync,
+[SYS_datamode] sys_datamode,
+[SYS_clone]   sys_clone,
 };
 
 void
@@ -138,7 +176,10 @@ syscall(void)
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
-    p->trapframe->a0 = syscalls[num]();
+    if(p->traced > 0)
+      p->trapframe->a0 = tracesyscall(num, syscalls[num]);
+    else
+      p->trapframe->a0 = syscalls[num]();
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
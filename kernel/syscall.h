@@ -20,3 +20,22 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_lseek  22
+#define SYS_mount  23
+#define SYS_irqaffinity 24
+#define SYS_irqstat 25
+#define SYS_lockbench 26
+#define SYS_kstat 27
+#define SYS_rcubench 28
+#define SYS_meminfo 29
+#define SYS_madvise 30
+#define SYS_mprotect 31
+#define SYS_sigsegv 32
+#define SYS_sigreturn 33
+#define SYS_procmem 34
+#define SYS_uptimeus 35
+#define SYS_trace 36
+#define SYS_tracedump 37
+#define SYS_fsync 38
+#define SYS_datamode 39
+#define SYS_clone 40
@@ -107,6 +107,19 @@ sys_close(void)
   return 0;
 }
 
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+
+  argint(1, &off);
+  argint(2, &whence);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return fileseek(f, off, whence);
+}
+
 uint64
 sys_fstat(void)
 {
@@ -119,6 +132,27 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+uint64
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return filesync(f);
+}
+
+// set how file data is written: DATA_JOURNAL or DATA_ORDERED.
+// returns the old mode.
+uint64
+sys_datamode(void)
+{
+  int mode;
+
+  argint(0, &mode);
+  return log_datamode(mode);
+}
+
 // Create the path new as a link to the same inode as old.
 uint64
 sys_link(void)
@@ -214,7 +248,8 @@ sys_unlink(void)
 
   if(ip->nlink < 1)
     panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
+  // a mount point stays while the file system is mounted.
+  if(ip->type == T_DIR && (!isdirempty(ip) || imounted(ip))){
     iunlockput(ip);
     goto bad;
   }
@@ -359,10 +394,14 @@ sys_open(void)
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->synconclose = (omode & O_SYNCCLOSE) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){
-    itrunc(ip);
+    itruncdefer(ip);
   }
+  // a file that already has data keeps its format.
+  if((omode & O_COMPRESS) && ip->type == T_FILE)
+    icompress(ip);
 
   iunlock(ip);
   end_op();
@@ -396,6 +435,11 @@ sys_mknod(void)
   begin_op();
   argint(1, &major);
   argint(2, &minor);
+  // the disk inode has a byte for each.
+  if(major < 0 || major > 0xFF || minor < 0 || minor > 0xFF){
+    end_op();
+    return -1;
+  }
   if((argstr(0, path, MAXPATH)) < 0 ||
      (ip = create(path, T_DEVICE, major, minor)) == 0){
     end_op();
@@ -406,6 +450,74 @@ sys_mknod(void)
   return 0;
 }
 
+// Create the regular file new as a copy of old that shares its
+// data blocks until one of them writes a block. new may already
+// exist if it is empty; if the clone fails it is left so.
+uint64
+sys_clone(void)
+{
+  char new[MAXPATH], old[MAXPATH];
+  struct inode *ip, *np;
+  int r = -1;
+
+  if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
+    return -1;
+
+  begin_op();
+  if((ip = namei(old)) == 0){
+    end_op();
+    return -1;
+  }
+  if((np = create(new, T_FILE, 0, 0)) == 0){
+    iput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(np);
+
+  if(np != ip && np->dev == ip->dev){
+    // lock in inode order, against a clone the other way.
+    ilock(ip->inum < np->inum ? ip : np);
+    ilock(ip->inum < np->inum ? np : ip);
+    if(ip->type == T_FILE && np->type == T_FILE)
+      r = iclone(ip, np);
+    iunlock(np);
+    iunlock(ip);
+  }
+  iput(np);
+  iput(ip);
+  end_op();
+  return r;
+}
+
+// Mount the file system on device dev over the directory path.
+uint64
+sys_mount(void)
+{
+  char path[MAXPATH];
+  struct inode *ip;
+  int dev;
+
+  argint(1, &dev);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  if(fsmount(ip, dev) < 0){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(ip);  // the mount table keeps the reference.
+  end_op();
+  return 0;
+}
+
 uint64
 sys_chdir(void)
 {
@@ -434,43 +546,62 @@ sys_chdir(void)
 uint64
 sys_exec(void)
 {
-  char path[MAXPATH], *argv[MAXARG];
-  int i;
-  uint64 uargv, uarg;
+  char path[MAXPATH], *pages[MAXARGPAGES];
+  int i, n, argc, pg, off;
+  uint64 uargv, uarg, *argv;
 
   argaddr(1, &uargv);
   if(argstr(0, path, MAXPATH) < 0) {
     return -1;
   }
-  memset(argv, 0, sizeof(argv));
-  for(i=0;; i++){
-    if(i >= NELEM(argv)){
-      goto bad;
-    }
-    if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0){
-      goto bad;
-    }
-    if(uarg == 0){
-      argv[i] = 0;
+
+  // count the arguments, so that the argv[] array can
+  // go at the start of the buffer, ahead of the strings.
+  for(argc=0;; argc++){
+    if(argc > MAXARG)
+      return -1;
+    if(fetchaddr(uargv+sizeof(uint64)*argc, (uint64*)&uarg) < 0)
+      return -1;
+    if(uarg == 0)
       break;
-    }
-    argv[i] = kalloc();
-    if(argv[i] == 0)
-      goto bad;
-    if(fetchstr(uarg, argv[i], PGSIZE) < 0)
+  }
+
+  // pack argv[] and the strings into as few pages as possible,
+  // laid out as they will be on the user stack; argv[] holds
+  // offsets into the buffer until exec() knows where it goes.
+  // a string that does not fit in the rest of a page starts
+  // on the next one.
+  memset(pages, 0, sizeof(pages));
+  if((pages[0] = kalloc()) == 0)
+    return -1;
+  argv = (uint64*)pages[0];
+  pg = 0;
+  off = ((argc+1)*sizeof(uint64) + 15) & ~15;
+  for(i = 0; i < argc; i++){
+    if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0)
       goto bad;
+    while((n = fetchstr(uarg, pages[pg] + off, PGSIZE - off)) < 0){
+      if(off == 0)
+        goto bad;  // longer than a page, or a bad address.
+      if(++pg >= MAXARGPAGES || (pages[pg] = kalloc()) == 0)
+        goto bad;
+      off = 0;
+    }
+    argv[i] = pg*PGSIZE + off;
+    off += n + 1;
   }
+  argv[argc] = 0;
 
-  int ret = exec(path, argv);
+  int ret = exec(path, pages, pg*PGSIZE + off);
 
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
+  for(i = 0; i < MAXARGPAGES && pages[i] != 0; i++)
+    kfree(pages[i]);
 
   return ret;
 
  bad:
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
+  for(i = 0; i < MAXARGPAGES && pages[i] != 0; i++)
+    kfree(pages[i]);
   return -1;
 }
 
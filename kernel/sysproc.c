@@ -5,6 +5,9 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "kstat.h"
+#include "fs.h"
+#include "mman.h"
 
 uint64
 sys_exit(void)
@@ -54,6 +57,121 @@ sys_sbrk(void)
   return addr;
 }
 
+// does [addr, end) include the guard page at the bottom of
+// p's stack? it must stay unmapped.
+static int
+overguard(struct proc *p, uint64 addr, uint64 end)
+{
+  return p->stacktop && addr < p->stackbot + PGSIZE && end > p->stackbot;
+}
+
+// advise the kernel how a range of lazily allocated
+// memory will be used.
+uint64
+sys_madvise(void)
+{
+  uint64 addr, len, end, a;
+  int advice;
+  pte_t *pte;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &advice);
+  end = addr + len;
+  if(addr % PGSIZE != 0 || end < addr || end > p->sz || overguard(p, addr, end))
+    return -1;
+
+  if(advice == MADV_NORMAL){
+    if(addr < p->seqend && end > p->seqstart)
+      p->seqstart = p->seqend = 0;
+  } else if(advice == MADV_SEQUENTIAL){
+    p->seqstart = addr;
+    p->seqend = end;
+  } else if(advice == MADV_WILLNEED){
+    if(uvmprefault(p->pagetable, addr, end) < 0)
+      return -1;
+  } else if(advice == MADV_DONTNEED){
+    // loaded text and data would come back as zeroes.
+    if(addr < p->imgend)
+      return -1;
+    // nor pages mprotect()ed below read-write: they would
+    // refault read-write.
+    for(a = addr; a < end; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) != 0 && (*pte & PTE_V) &&
+         ((*pte & PTE_U) == 0 || (*pte & (PTE_W|PTE_COW)) == 0))
+        return -1;
+    }
+    uvmunmap(p->pagetable, addr, PGROUNDUP(end - addr) / PGSIZE, 1);
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+// report the memory of process pid, or of the caller if pid is 0.
+uint64
+sys_procmem(void)
+{
+  int pid;
+  uint64 addr;
+  struct procmem pm;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(pid == 0)
+    pid = myproc()->pid;
+  if(procmem(pid, &pm) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char *)&pm, sizeof(pm)) < 0)
+    return -1;
+  return 0;
+}
+
+// change the protection of a page-aligned range of memory.
+uint64
+sys_mprotect(void)
+{
+  uint64 addr, len, end;
+  int prot;
+  struct proc *p = myproc();
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &prot);
+  end = addr + len;
+  if(addr % PGSIZE != 0 || end < addr || end > p->sz || overguard(p, addr, end))
+    return -1;
+  if(prot & ~(PROT_READ|PROT_WRITE|PROT_EXEC))
+    return -1;
+  return uvmprotect(p->pagetable, addr, end, prot);
+}
+
+// run handler(va) on a disallowed access to va instead of
+// killing the process; handler 0 restores the default.
+uint64
+sys_sigsegv(void)
+{
+  uint64 handler;
+
+  argaddr(0, &handler);
+  myproc()->segvhandler = handler;
+  return 0;
+}
+
+// return from a sigsegv() handler to the faulting access.
+uint64
+sys_sigreturn(void)
+{
+  struct proc *p = myproc();
+
+  if(!p->insegv)
+    return -1;
+  *p->trapframe = p->segvframe;
+  p->insegv = 0;
+  return p->trapframe->a0;  // syscall() stores this in a0
+}
+
 uint64
 sys_sleep(void)
 {
@@ -95,3 +213,135 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// microseconds since boot, from the CLINT's timer,
+// for timing that ticks are too coarse for.
+uint64
+sys_uptimeus(void)
+{
+  return r_time() / (MTIMEFREQ / 1000000);
+}
+
+// start or stop recording the system calls of process pid,
+// or of the caller if pid is 0.
+uint64
+sys_trace(void)
+{
+  int pid, on;
+
+  argint(0, &pid);
+  argint(1, &on);
+  if(pid == 0)
+    pid = myproc()->pid;
+  return traceattach(pid, on != 0);
+}
+
+// read recorded system calls.
+uint64
+sys_tracedump(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return tracedump(addr, n);
+}
+
+// route a device IRQ to a set of harts.
+uint64
+sys_irqaffinity(void)
+{
+  int irq, mask;
+
+  argint(0, &irq);
+  argint(1, &mask);
+  return plic_setaffinity(irq, mask);
+}
+
+// copy out an IRQ's per-hart interrupt counts and
+// return its affinity mask.
+uint64
+sys_irqstat(void)
+{
+  int irq, aff;
+  uint64 addr;
+  uint64 counts[NCPU];
+
+  argint(0, &irq);
+  argaddr(1, &addr);
+  if((aff = plic_stat(irq, counts)) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char *)counts, sizeof(counts)) < 0)
+    return -1;
+  return aff;
+}
+
+// hammer a benchmark spinlock of the given type for
+// some ticks; returns the number of acquisitions.
+uint64
+sys_lockbench(void)
+{
+  int type, nticks;
+
+  argint(0, &type);
+  argint(1, &nticks);
+  return lockbench(type, nticks);
+}
+
+// time pid lookups with and without RCU.
+uint64
+sys_rcubench(void)
+{
+  int rcu, nticks;
+
+  argint(0, &rcu);
+  argint(1, &nticks);
+  return rcubench(rcu, nticks);
+}
+
+// copy out the kernel's event counters.
+uint64
+sys_kstat(void)
+{
+  uint64 addr;
+  struct kstat ks;
+  struct cpu *c;
+
+  argaddr(0, &addr);
+  memset(&ks, 0, sizeof(ks));
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    ks.nswtch += c->nswtch;
+    ks.nbread += c->nbread;
+    ks.nsleepspin += c->nsleepspin;
+    ks.nsleepblock += c->nsleepblock;
+    ks.nlazyfault += c->nlazyfault;
+    ks.ncowfault += c->ncowfault;
+    ks.ntracedrop += c->ntracedrop;
+    ks.ndiskread += c->ndiskread;
+    ks.ndiskwrite += c->ndiskwrite;
+  }
+  kallocstat(&ks);
+  if(copyout(myproc()->pagetable, addr, (char *)&ks, sizeof(ks)) < 0)
+    return -1;
+  return 0;
+}
+
+// copy out physical memory usage.
+uint64
+sys_meminfo(void)
+{
+  uint64 addr;
+  struct meminfo mi;
+
+  argaddr(0, &addr);
+  memset(&mi, 0, sizeof(mi));
+  kallocinfo(&mi);
+  mi.ptpages = vmptpages();
+  mi.bufpages = (NBUF*BSIZE + PGSIZE - 1) / PGSIZE;
+  if(copyout(myproc()->pagetable, addr, (char *)&mi, sizeof(mi)) < 0)
+    return -1;
+  return 0;
+}
@@ -0,0 +1,190 @@
+//
+// system call tracing, for capturing workloads to replay.
+//
+// syscall() hands the calls of a traced process to
+// tracesyscall(), which appends a record of each to a ring
+// that a reader drains with tracedump(). children inherit
+// tracing. when the ring is full, records are dropped and
+// counted rather than slowing the traced processes down.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "syscall.h"
+#include "trace.h"
+#include "defs.h"
+
+static struct {
+  struct spinlock lock;
+  struct tracerec rec[NTRACE];
+  uint head, tail;  // rec[tail..head), mod NTRACE, wait to be read
+  int ntraced;      // live traced processes
+} trace;
+
+// calls whose first argument is a path.
+static char pathcall[] = {
+[SYS_exec]   1,
+[SYS_open]   1,
+[SYS_mknod]  1,
+[SYS_unlink] 1,
+[SYS_link]   1,
+[SYS_mkdir]  1,
+[SYS_chdir]  1,
+[SYS_mount]  1,
+[SYS_clone]  1,
+};
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+}
+
+static void
+traceput(struct tracerec *r)
+{
+  acquire(&trace.lock);
+  if(trace.head - trace.tail == NTRACE){
+    mycpu()->ntracedrop++;
+  } else {
+    trace.rec[trace.head++ % NTRACE] = *r;
+    wakeup(&trace);
+  }
+  release(&trace.lock);
+}
+
+// run system call num for the current, traced, process,
+// and record it.
+uint64
+tracesyscall(int num, uint64 (*fn)(void))
+{
+  struct proc *p = myproc();
+  struct tracerec r;
+
+  memset(&r, 0, sizeof(r));
+  r.time = r_time() / (MTIMEFREQ / 1000000);
+  r.pid = p->pid;
+  r.num = num;
+  r.arg[0] = p->trapframe->a0;
+  r.arg[1] = p->trapframe->a1;
+  r.arg[2] = p->trapframe->a2;
+  if(num < NELEM(pathcall) && pathcall[num])
+    fetchstr(r.arg[0], r.path, TRACEPATH);
+  if(num == SYS_exit)
+    traceput(&r);  // exit() does not return
+  r.ret = fn();
+  if(num == SYS_fork && (int)r.ret > 0)
+    return r.ret;  // tracefork() recorded it
+  traceput(&r);
+  return r.ret;
+}
+
+// start (on) or stop tracing process pid.
+// returns 0, or -1 if there is no such live process.
+// p->traced is written holding trace.lock, and p->lock
+// except by the process itself; -1 means exited.
+int
+traceattach(int pid, int on)
+{
+  struct proc *p;
+  int r = -1;
+
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  acquire(&trace.lock);
+  acquire(&p->lock);
+  if(p->pid == pid && p->traced >= 0){
+    if(on && !p->traced)
+      trace.ntraced++;
+    else if(!on && p->traced)
+      trace.ntraced--;
+    p->traced = on;
+    wakeup(&trace);
+    r = 0;
+  }
+  release(&p->lock);
+  release(&trace.lock);
+  return r;
+}
+
+// np, a child of the current, traced, process, is not yet
+// runnable; trace it too. the fork is recorded here, before
+// any call of the child's, so that replay knows the child's
+// descriptors when it sees them used.
+void
+tracefork(struct proc *np)
+{
+  struct tracerec r;
+
+  acquire(&trace.lock);
+  acquire(&np->lock);
+  np->traced = 1;
+  trace.ntraced++;
+  release(&np->lock);
+  release(&trace.lock);
+
+  memset(&r, 0, sizeof(r));
+  r.time = r_time() / (MTIMEFREQ / 1000000);
+  r.pid = myproc()->pid;
+  r.num = SYS_fork;
+  r.ret = np->pid;
+  traceput(&r);
+}
+
+// the current process is exiting; stop tracing it, for good.
+void
+traceexit(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&trace.lock);
+  if(p->traced > 0){
+    trace.ntraced--;
+    wakeup(&trace);
+  }
+  p->traced = -1;
+  release(&trace.lock);
+}
+
+// copy up to n records to user address dst, waiting for some
+// while any process is traced. returns the number copied; 0
+// once no process is traced and every record has been read; -1
+// if the first copyout fails, leaving that record to be read.
+int
+tracedump(uint64 dst, int n)
+{
+  struct proc *p = myproc();
+  struct tracerec r;
+  uint t;
+  int i;
+
+  acquire(&trace.lock);
+  while(trace.head == trace.tail && trace.ntraced > 0){
+    if(killed(p)){
+      release(&trace.lock);
+      return -1;
+    }
+    sleep(&trace, &trace.lock);
+  }
+  for(i = 0; i < n && trace.tail != trace.head; ){
+    t = trace.tail;
+    r = trace.rec[t % NTRACE];
+    // copyout() may fault in the destination page. the record
+    // stays in the ring until it has been copied out.
+    release(&trace.lock);
+    if(copyout(p->pagetable, dst + i*sizeof(r), (char*)&r, sizeof(r)) < 0)
+      return i > 0 ? i : -1;
+    acquire(&trace.lock);
+    // unless another reader took it meanwhile.
+    if(trace.tail == t){
+      trace.tail++;
+      i++;
+    }
+  }
+  release(&trace.lock);
+  return i;
+}
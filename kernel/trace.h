@@ -0,0 +1,12 @@
+// a system call, as recorded for a traced process and
+// returned by the tracedump system call.
+#define TRACEPATH 32
+
+struct tracerec {
+  uint64 time;           // microseconds since boot, at entry
+  uint64 arg[3];         // a0-a2 at entry
+  uint64 ret;            // return value; 0 for exit
+  int pid;
+  int num;               // SYS_* number
+  char path[TRACEPATH];  // first argument of calls that take a path
+};
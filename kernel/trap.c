@@ -15,6 +15,7 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+static void segv(struct proc*, uint64);
 
 void
 trapinit(void)
@@ -67,36 +68,38 @@ usertrap(void)
     syscall();
   } else if(r_scause() == 13) { // Load page fault
     // page fault set stval register to hold the fault va
-    uint64 va = r_stval(); 
-    if (va >= MAXVA)
-      exit(-1);
-      
-    pte_t *pte = walk(p->pagetable, va, 0);
-    if (pte == 0 || (*pte & PTE_V) == 0) {
-      if (lazyalloc_pagefault_handler(p, va) != 0)
-        setkilled(p);
+    uint64 va = r_stval();
+    if (va >= MAXVA) {
+      segv(p, va);
     } else {
-      setkilled(p);
+      pte_t *pte = walk(p->pagetable, va, 0);
+      if (pte == 0 || (*pte & PTE_V) == 0) {
+        if (lazyalloc_pagefault_handler(p, va) != 0)
+          segv(p, va);
+      } else {
+        segv(p, va);  // PROT_NONE, or the stack guard page
+      }
     }
-    
   } else if (r_scause() == 15) { // Store/AMO page fault
     // page fault set stval register to hold the fault va
     uint64 va = r_stval();
-    int is_handled = 0;
-    if (va >= MAXVA)
-      exit(-1);
-
-    pte_t *pte = walk(p->pagetable, va, 0);
-    if (pte == 0 || (*pte & PTE_V) == 0) {
-      if (lazyalloc_pagefault_handler(p, va) != 0) {
-        exit(-1);
+    if (va >= MAXVA) {
+      segv(p, va);
+    } else {
+      pte_t *pte = walk(p->pagetable, va, 0);
+      if (pte == 0 || (*pte & PTE_V) == 0) {
+        if (lazyalloc_pagefault_handler(p, va) != 0)
+          segv(p, va);
+      } else if ((*pte & PTE_U) == 0) {
+        segv(p, va);
       } else {
-        is_handled = 1;
+        int r = cow_pagefault_handler(p->pagetable, va);
+        if (r == 1)
+          segv(p, va);  // not writable, and not copy-on-write
+        else if (r != 0)
+          setkilled(p);
       }
     }
-
-    if (cow_pagefault_handler(p->pagetable, va) != 0 && !is_handled)
-      setkilled(p);
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
@@ -220,8 +223,8 @@ devintr()
 
     if(irq == UART0_IRQ){
       uartintr();
-    } else if(irq == VIRTIO0_IRQ){
-      virtio_disk_intr();
+    } else if(irq >= VIRTIO_IRQ(0) && irq < VIRTIO_IRQ(NVIRTIO)){
+      virtio_disk_intr(irq - VIRTIO0_IRQ);
     } else if(irq){
       printf("unexpected interrupt irq=%d\n", irq);
     }
@@ -251,15 +254,40 @@ devintr()
   }
 }
 
+// a user access to va was not allowed. run the process's
+// sigsegv() handler, with va as its argument, if it has one
+// and is not already in it; otherwise kill the process.
+// the handler ends by calling sigreturn(), which restores
+// the registers saved here and retries the access.
+static void
+segv(struct proc *p, uint64 va)
+{
+  if (p->segvhandler == 0 || p->insegv) {
+    setkilled(p);
+    return;
+  }
+  p->segvframe = *p->trapframe;
+  p->insegv = 1;
+  p->trapframe->epc = p->segvhandler;
+  p->trapframe->a0 = va;
+}
+
 int 
 lazyalloc_pagefault_handler(struct proc *p, uint64 va)
 {
   char* mem;
+  pte_t *pte;
 
   // for lazy allocation fault, va shouldn't exceed what the program asked sbrk to allocate 
-  // nor go below the allocated stack into the guard page
+  // nor go below the stack pointer: the page under sp acts as a guard page, which moves
+  // down as the stack grows. the bottom page of the stack reservation is a fixed guard.
   if (va >= p->sz || va < PGROUNDDOWN(p->trapframe->sp))
     return -1;
+  if (p->stacktop && va >= p->stackbot && va < p->stackbot + PGSIZE)
+    return -1;
+  // a mapped page, e.g. one mprotect()ed PROT_NONE, is not lazy.
+  if ((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V))
+    return -1;
     
   if ((mem = kalloc()) == 0)
     return -1;
@@ -269,6 +297,25 @@ lazyalloc_pagefault_handler(struct proc *p, uint64 va)
     printf("lazy_alloc_pagefault_handler: failed to install new pages\n");
     return -1;
   }
+  push_off();
+  mycpu()->nlazyfault++;
+  pop_off();
+  if (va >= p->stackbot && va < p->stacklow)
+    p->stacklow = PGROUNDDOWN(va);
+
+  // fault-around: in a region madvise()d MADV_SEQUENTIAL,
+  // map the next few pages too, saving their faults.
+  if (va >= p->seqstart && va < p->seqend) {
+    uint64 end = PGROUNDDOWN(va) + FAULTAROUND*PGSIZE;
+    if (end > p->seqend)
+      end = p->seqend;
+    if (end > p->sz)
+      end = p->sz;
+    // stop short of the stack's guard page.
+    if (p->stacktop && va < p->stackbot && end > p->stackbot)
+      end = p->stackbot;
+    uvmprefault(p->pagetable, PGROUNDDOWN(va) + PGSIZE, end);
+  }
   return 0;
 }
 
@@ -306,6 +353,9 @@ cow_pagefault_handler(pagetable_t pagetable, uint64 va)
       printf("cow_pagefault_handler(): failed to install new page\n");
       return -1;
     }
+    push_off();
+    mycpu()->ncowfault++;
+    pop_off();
     return 0;
   }
 
@@ -14,7 +14,9 @@
 #define VIRTIO_MMIO_DEVICE_ID		0x008 // device type; 1 is net, 2 is disk
 #define VIRTIO_MMIO_VENDOR_ID		0x00c // 0x554d4551
 #define VIRTIO_MMIO_DEVICE_FEATURES	0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL	0x014 // which 32-bit feature word to read
 #define VIRTIO_MMIO_DRIVER_FEATURES	0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL	0x024 // which 32-bit feature word to write
 #define VIRTIO_MMIO_QUEUE_SEL		0x030 // select queue, write-only
 #define VIRTIO_MMIO_QUEUE_NUM_MAX	0x034 // max size of current queue, read-only
 #define VIRTIO_MMIO_QUEUE_NUM		0x038 // size of current queue, write-only
@@ -44,6 +46,8 @@
 #define VIRTIO_F_ANY_LAYOUT         27
 #define VIRTIO_RING_F_INDIRECT_DESC 28
 #define VIRTIO_RING_F_EVENT_IDX     29
+#define VIRTIO_F_VERSION_1          32
+#define VIRTIO_F_RING_PACKED        34	/* descriptors and completions share one ring */
 
 // this many virtio descriptors.
 // must be a power of two.
@@ -80,6 +84,30 @@ struct virtq_used {
   struct virtq_used_elem ring[NUM];
 };
 
+// a packed virtqueue (Section 2.8 of the spec) replaces the
+// three split rings with a single ring of descriptors. the driver
+// makes a descriptor available by writing it with the AVAIL bit
+// equal to its wrap counter (and USED to the inverse); the device
+// marks it used by writing back both bits equal to its own wrap
+// counter. both wrap counters start at 1 and flip each time the
+// respective index wraps around the ring.
+struct pvirtq_desc {
+  uint64 addr;
+  uint32 len;
+  uint16 id;    // buffer id, echoed back by the device when used
+  uint16 flags;
+};
+#define VRING_PACKED_DESC_F_AVAIL (1 << 7)
+#define VRING_PACKED_DESC_F_USED  (1 << 15)
+
+// the driver and device event suppression areas of a packed ring.
+struct pvirtq_event_suppress {
+  uint16 desc;
+  uint16 flags;
+};
+#define RING_EVENT_FLAGS_ENABLE  0x0
+#define RING_EVENT_FLAGS_DISABLE 0x1
+
 // these are specific to virtio block devices, e.g. disks,
 // described in Section 5.2 of the spec.
 
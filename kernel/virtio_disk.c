@@ -1,9 +1,16 @@
 //
-// driver for qemu's virtio disk device.
+// driver for qemu's virtio disk devices.
 // uses qemu's mmio interface to virtio.
 //
 // qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
 //
+// every virtio-mmio slot holding a block device becomes a disk
+// unit, numbered in slot order, with its own queue and lock.
+//
+// if the device offers VIRTIO_F_RING_PACKED (qemu: packed=on),
+// the driver uses a packed virtqueue; otherwise it falls back
+// to the split virtqueue layout.
+//
 
 #include "types.h"
 #include "riscv.h"
@@ -16,10 +23,16 @@
 #include "buf.h"
 #include "virtio.h"
 
-// the address of virtio mmio register r.
-#define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
+// the address of virtio mmio register r of disk d.
+#define R(d, r) ((volatile uint32 *)((d)->base + (r)))
+
+struct disk {
+  uint64 base;     // mmio registers.
+
+  int packed;      // negotiated VIRTIO_F_RING_PACKED?
+
+  // split virtqueue.
 
-static struct disk {
   // a set (not a ring) of DMA descriptors, with which the
   // driver tells the device where to read and write individual
   // disk operations. there are NUM descriptors.
@@ -38,53 +51,87 @@ static struct disk {
   // there are NUM used ring entries.
   struct virtq_used *used;
 
+  // packed virtqueue.
+
+  // a single ring of NUM descriptors, written in order by the
+  // driver and overwritten in order by the device as requests
+  // complete.
+  struct pvirtq_desc *ring;
+  struct pvirtq_event_suppress *driver_event;
+  struct pvirtq_event_suppress *device_event;
+  uint16 avail_idx;  // next ring slot the driver will fill.
+  uint16 avail_wrap; // driver's wrap counter.
+  uint16 used_wrap;  // wrap counter expected at used_idx.
+  int nslots;        // ring slots not owned by the device.
+
   // our own book-keeping.
+  // free descriptors (split) or free buffer ids (packed) form a
+  // singly-linked list through free_next[], so allocation is O(1).
   char free[NUM];  // is a descriptor free?
-  uint16 used_idx; // we've looked this far in used[2..NUM].
+  uint16 free_next[NUM];
+  int free_head;   // first free descriptor.
+  int nfree;       // length of the free list.
+  uint16 used_idx; // we've looked this far in used[2..NUM] (or ring[]).
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
-  // indexed by first descriptor index of chain.
+  // indexed by first descriptor index of chain (split)
+  // or by buffer id (packed).
   struct {
     struct buf *b;
     char status;
+    uchar ndesc;   // ring slots used by the request (packed).
   } info[NUM];
 
   // disk command headers.
   // one-for-one with descriptors, for convenience.
   struct virtio_blk_req ops[NUM];
-  
+
   struct spinlock vdisk_lock;
-  
-} disk;
 
-void
-virtio_disk_init(void)
+};
+
+// indexed by virtio-mmio slot.
+static struct disk disks[NVIRTIO];
+
+// slot of each disk unit, in probe order.
+static int units[NVIRTIO];
+static int nunits;
+
+// is there a virtio block device at d->base?
+static int
+probe(struct disk *d)
+{
+  return *R(d, VIRTIO_MMIO_MAGIC_VALUE) == 0x74726976 &&
+    *R(d, VIRTIO_MMIO_VERSION) == 2 &&
+    *R(d, VIRTIO_MMIO_DEVICE_ID) == 2 &&
+    *R(d, VIRTIO_MMIO_VENDOR_ID) == 0x554d4551;
+}
+
+static void
+disk_init(struct disk *d)
 {
   uint32 status = 0;
 
-  initlock(&disk.vdisk_lock, "virtio_disk");
+  initlock(&d->vdisk_lock, "virtio_disk");
 
-  if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
-     *R(VIRTIO_MMIO_VERSION) != 2 ||
-     *R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
-     *R(VIRTIO_MMIO_VENDOR_ID) != 0x554d4551){
-    panic("could not find virtio disk");
-  }
-  
   // reset device
-  *R(VIRTIO_MMIO_STATUS) = status;
+  *R(d, VIRTIO_MMIO_STATUS) = status;
 
   // set ACKNOWLEDGE status bit
   status |= VIRTIO_CONFIG_S_ACKNOWLEDGE;
-  *R(VIRTIO_MMIO_STATUS) = status;
+  *R(d, VIRTIO_MMIO_STATUS) = status;
 
   // set DRIVER status bit
   status |= VIRTIO_CONFIG_S_DRIVER;
-  *R(VIRTIO_MMIO_STATUS) = status;
-
-  // negotiate features
-  uint64 features = *R(VIRTIO_MMIO_DEVICE_FEATURES);
+  *R(d, VIRTIO_MMIO_STATUS) = status;
+
+  // negotiate features. feature bits above 31 live in the
+  // second feature word.
+  *R(d, VIRTIO_MMIO_DEVICE_FEATURES_SEL) = 0;
+  uint64 features = *R(d, VIRTIO_MMIO_DEVICE_FEATURES);
+  *R(d, VIRTIO_MMIO_DEVICE_FEATURES_SEL) = 1;
+  features |= (uint64)*R(d, VIRTIO_MMIO_DEVICE_FEATURES) << 32;
   features &= ~(1 << VIRTIO_BLK_F_RO);
   features &= ~(1 << VIRTIO_BLK_F_SCSI);
   features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
@@ -92,103 +139,163 @@ virtio_disk_init(void)
   features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
   features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
   features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
-  *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+  // of the high feature bits, only accept the ones we implement.
+  features &= 0xffffffffL | (1L << VIRTIO_F_VERSION_1) | (1L << VIRTIO_F_RING_PACKED);
+  *R(d, VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 0;
+  *R(d, VIRTIO_MMIO_DRIVER_FEATURES) = features;
+  *R(d, VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 1;
+  *R(d, VIRTIO_MMIO_DRIVER_FEATURES) = features >> 32;
+  d->packed = (features >> VIRTIO_F_RING_PACKED) & 1;
 
   // tell device that feature negotiation is complete.
   status |= VIRTIO_CONFIG_S_FEATURES_OK;
-  *R(VIRTIO_MMIO_STATUS) = status;
+  *R(d, VIRTIO_MMIO_STATUS) = status;
 
   // re-read status to ensure FEATURES_OK is set.
-  status = *R(VIRTIO_MMIO_STATUS);
+  status = *R(d, VIRTIO_MMIO_STATUS);
   if(!(status & VIRTIO_CONFIG_S_FEATURES_OK))
     panic("virtio disk FEATURES_OK unset");
 
   // initialize queue 0.
-  *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
+  *R(d, VIRTIO_MMIO_QUEUE_SEL) = 0;
 
   // ensure queue 0 is not in use.
-  if(*R(VIRTIO_MMIO_QUEUE_READY))
+  if(*R(d, VIRTIO_MMIO_QUEUE_READY))
     panic("virtio disk should not be ready");
 
   // check maximum queue size.
-  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
+  uint32 max = *R(d, VIRTIO_MMIO_QUEUE_NUM_MAX);
   if(max == 0)
     panic("virtio disk has no queue 0");
   if(max < NUM)
     panic("virtio disk max queue too short");
 
   // allocate and zero queue memory.
-  disk.desc = kalloc();
-  disk.avail = kalloc();
-  disk.used = kalloc();
-  if(!disk.desc || !disk.avail || !disk.used)
+  // for a packed queue, the three pages hold the descriptor
+  // ring and the driver and device event suppression areas.
+  void *q0 = kalloc();
+  void *q1 = kalloc();
+  void *q2 = kalloc();
+  if(!q0 || !q1 || !q2)
     panic("virtio disk kalloc");
-  memset(disk.desc, 0, PGSIZE);
-  memset(disk.avail, 0, PGSIZE);
-  memset(disk.used, 0, PGSIZE);
+  memset(q0, 0, PGSIZE);
+  memset(q1, 0, PGSIZE);
+  memset(q2, 0, PGSIZE);
+  if(d->packed){
+    d->ring = q0;
+    d->driver_event = q1;
+    d->device_event = q2;
+    d->driver_event->flags = RING_EVENT_FLAGS_ENABLE;
+  } else {
+    d->desc = q0;
+    d->avail = q1;
+    d->used = q2;
+  }
 
   // set queue size.
-  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+  *R(d, VIRTIO_MMIO_QUEUE_NUM) = NUM;
 
   // write physical addresses.
-  *R(VIRTIO_MMIO_QUEUE_DESC_LOW) = (uint64)disk.desc;
-  *R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)disk.desc >> 32;
-  *R(VIRTIO_MMIO_DRIVER_DESC_LOW) = (uint64)disk.avail;
-  *R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)disk.avail >> 32;
-  *R(VIRTIO_MMIO_DEVICE_DESC_LOW) = (uint64)disk.used;
-  *R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)disk.used >> 32;
+  *R(d, VIRTIO_MMIO_QUEUE_DESC_LOW) = (uint64)q0;
+  *R(d, VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)q0 >> 32;
+  *R(d, VIRTIO_MMIO_DRIVER_DESC_LOW) = (uint64)q1;
+  *R(d, VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)q1 >> 32;
+  *R(d, VIRTIO_MMIO_DEVICE_DESC_LOW) = (uint64)q2;
+  *R(d, VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)q2 >> 32;
 
   // queue is ready.
-  *R(VIRTIO_MMIO_QUEUE_READY) = 0x1;
+  *R(d, VIRTIO_MMIO_QUEUE_READY) = 0x1;
+
+  // all NUM descriptors (or buffer ids) start out unused.
+  for(int i = 0; i < NUM; i++){
+    d->free[i] = 1;
+    d->free_next[i] = i + 1;
+  }
+  d->free_head = 0;
+  d->nfree = NUM;
 
-  // all NUM descriptors start out unused.
-  for(int i = 0; i < NUM; i++)
-    disk.free[i] = 1;
+  // both packed-ring wrap counters start out set.
+  d->avail_wrap = 1;
+  d->used_wrap = 1;
+  d->nslots = NUM;
 
   // tell device we're completely ready.
   status |= VIRTIO_CONFIG_S_DRIVER_OK;
-  *R(VIRTIO_MMIO_STATUS) = status;
+  *R(d, VIRTIO_MMIO_STATUS) = status;
 
-  // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+  // plic.c and trap.c arrange for interrupts from VIRTIO_IRQ(slot).
 }
 
-// find a free descriptor, mark it non-free, return its index.
-static int
-alloc_desc()
+// find and initialize all virtio disks.
+void
+virtio_disk_init(void)
 {
-  for(int i = 0; i < NUM; i++){
-    if(disk.free[i]){
-      disk.free[i] = 0;
-      return i;
+  for(int i = 0; i < NVIRTIO; i++){
+    struct disk *d = &disks[i];
+    d->base = VIRTIO(i);
+    if(!probe(d)){
+      d->base = 0;
+      continue;
     }
+    disk_init(d);
+    units[nunits++] = i;
   }
-  return -1;
+  if(nunits == 0)
+    panic("could not find virtio disk");
 }
 
-// mark a descriptor as free.
+// number of disk units found by virtio_disk_init().
+int
+virtio_disk_count(void)
+{
+  return nunits;
+}
+
+// pop a free descriptor off the free list, mark it non-free,
+// return its index.
+static int
+alloc_desc(struct disk *d)
+{
+  int i;
+
+  if(d->nfree == 0)
+    return -1;
+  i = d->free_head;
+  d->free_head = d->free_next[i];
+  d->nfree--;
+  d->free[i] = 0;
+  return i;
+}
+
+// mark a descriptor as free and push it on the free list.
 static void
-free_desc(int i)
+free_desc(struct disk *d, int i)
 {
   if(i >= NUM)
     panic("free_desc 1");
-  if(disk.free[i])
+  if(d->free[i])
     panic("free_desc 2");
-  disk.desc[i].addr = 0;
-  disk.desc[i].len = 0;
-  disk.desc[i].flags = 0;
-  disk.desc[i].next = 0;
-  disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  if(!d->packed){
+    d->desc[i].addr = 0;
+    d->desc[i].len = 0;
+    d->desc[i].flags = 0;
+    d->desc[i].next = 0;
+  }
+  d->free[i] = 1;
+  d->free_next[i] = d->free_head;
+  d->free_head = i;
+  d->nfree++;
+  wakeup(&d->free[0]);
 }
 
 // free a chain of descriptors.
 static void
-free_chain(int i)
+free_chain(struct disk *d, int i)
 {
   while(1){
-    int flag = disk.desc[i].flags;
-    int nxt = disk.desc[i].next;
-    free_desc(i);
+    int flag = d->desc[i].flags;
+    int nxt = d->desc[i].next;
+    free_desc(d, i);
     if(flag & VRING_DESC_F_NEXT)
       i = nxt;
     else
@@ -199,43 +306,98 @@ free_chain(int i)
 // allocate three descriptors (they need not be contiguous).
 // disk transfers always use three descriptors.
 static int
-alloc3_desc(int *idx)
+alloc3_desc(struct disk *d, int *idx)
 {
-  for(int i = 0; i < 3; i++){
-    idx[i] = alloc_desc();
-    if(idx[i] < 0){
-      for(int j = 0; j < i; j++)
-        free_desc(idx[j]);
-      return -1;
-    }
-  }
+  if(d->nfree < 3)
+    return -1;
+  for(int i = 0; i < 3; i++)
+    idx[i] = alloc_desc(d);
   return 0;
 }
 
+// place one descriptor in the next packed ring slot.
+// returns the flags that make it available to the device;
+// they are stored too, unless this is the head of a chain,
+// whose flags the caller writes last.
+static uint16
+packed_put(struct disk *d, uint64 addr, uint32 len, uint16 id, uint16 flags, int head)
+{
+  struct pvirtq_desc *desc = &d->ring[d->avail_idx];
+
+  desc->addr = addr;
+  desc->len = len;
+  desc->id = id;
+  if(d->avail_wrap)
+    flags |= VRING_PACKED_DESC_F_AVAIL;
+  else
+    flags |= VRING_PACKED_DESC_F_USED;
+  if(!head)
+    desc->flags = flags;
+
+  if(++d->avail_idx == NUM){
+    d->avail_idx = 0;
+    d->avail_wrap ^= 1;
+  }
+  d->nslots--;
+  return flags;
+}
+
+// submit a request on the packed ring, using buffer id id.
+static void
+packed_submit(struct disk *d, int id, int write)
+{
+  struct virtio_blk_req *buf0 = &d->ops[id];
+  struct buf *b = d->info[id].b;
+  uint16 head = d->avail_idx;
+  uint16 headflags;
+
+  headflags = packed_put(d, (uint64) buf0, sizeof(struct virtio_blk_req), id,
+                         VRING_DESC_F_NEXT, 1);
+  packed_put(d, (uint64) b->data, BSIZE, id,
+             (write ? 0 : VRING_DESC_F_WRITE) | VRING_DESC_F_NEXT, 0);
+  packed_put(d, (uint64) &d->info[id].status, 1, id, VRING_DESC_F_WRITE, 0);
+  d->info[id].ndesc = 3;
+
+  // the device may start on the chain as soon as the head
+  // descriptor looks available, so write its flags last.
+  __sync_synchronize();
+  d->ring[head].flags = headflags;
+}
+
+// read or write b's data from block blockno of disk unit n.
 void
-virtio_disk_rw(struct buf *b, int write)
+virtio_disk_rw(int n, struct buf *b, uint blockno, int write)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
+  struct disk *d;
+  uint64 sector = (uint64)blockno * (BSIZE / 512);
+
+  if(n < 0 || n >= nunits)
+    panic("virtio_disk_rw: unit");
+  d = &disks[units[n]];
 
-  acquire(&disk.vdisk_lock);
+  acquire(&d->vdisk_lock);
 
   // the spec's Section 5.2 says that legacy block operations use
   // three descriptors: one for type/reserved/sector, one for the
   // data, one for a 1-byte status result.
 
-  // allocate the three descriptors.
+  // allocate the three descriptors, or, for a packed ring, a
+  // buffer id and three ring slots.
   int idx[3];
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(d->packed){
+      if(d->nslots >= 3 && (idx[0] = alloc_desc(d)) >= 0)
+        break;
+    } else if(alloc3_desc(d, idx) == 0) {
       break;
     }
-    sleep(&disk.free[0], &disk.vdisk_lock);
+    sleep(&d->free[0], &d->vdisk_lock);
   }
 
   // format the three descriptors.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
+  struct virtio_blk_req *buf0 = &d->ops[idx[0]];
 
   if(write)
     buf0->type = VIRTIO_BLK_T_OUT; // write the disk
@@ -244,57 +406,97 @@ virtio_disk_rw(struct buf *b, int write)
   buf0->reserved = 0;
   buf0->sector = sector;
 
-  disk.desc[idx[0]].addr = (uint64) buf0;
-  disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
-
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
-
-  disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  d->info[idx[0]].status = 0xff; // device writes 0 on success
 
   // record struct buf for virtio_disk_intr().
   b->disk = 1;
-  disk.info[idx[0]].b = b;
+  d->info[idx[0]].b = b;
+
+  if(d->packed){
+    packed_submit(d, idx[0], write);
+  } else {
+    d->desc[idx[0]].addr = (uint64) buf0;
+    d->desc[idx[0]].len = sizeof(struct virtio_blk_req);
+    d->desc[idx[0]].flags = VRING_DESC_F_NEXT;
+    d->desc[idx[0]].next = idx[1];
+
+    d->desc[idx[1]].addr = (uint64) b->data;
+    d->desc[idx[1]].len = BSIZE;
+    if(write)
+      d->desc[idx[1]].flags = 0; // device reads b->data
+    else
+      d->desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    d->desc[idx[1]].flags |= VRING_DESC_F_NEXT;
+    d->desc[idx[1]].next = idx[2];
 
-  // tell the device the first index in our chain of descriptors.
-  disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+    d->desc[idx[2]].addr = (uint64) &d->info[idx[0]].status;
+    d->desc[idx[2]].len = 1;
+    d->desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
+    d->desc[idx[2]].next = 0;
 
-  __sync_synchronize();
+    // tell the device the first index in our chain of descriptors.
+    d->avail->ring[d->avail->idx % NUM] = idx[0];
 
-  // tell the device another avail ring entry is available.
-  disk.avail->idx += 1; // not % NUM ...
+    __sync_synchronize();
+
+    // tell the device another avail ring entry is available.
+    d->avail->idx += 1; // not % NUM ...
+  }
 
   __sync_synchronize();
 
-  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+  // have the completion interrupt delivered here, if the
+  // disk's IRQ is set to follow the submitting hart.
+  plic_steer(VIRTIO_IRQ(d - disks));
+
+  *R(d, VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
   // Wait for virtio_disk_intr() to say request has finished.
   while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+    sleep(b, &d->vdisk_lock);
   }
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  d->info[idx[0]].b = 0;
+  if(d->packed)
+    free_desc(d, idx[0]);
+  else
+    free_chain(d, idx[0]);
+
+  release(&d->vdisk_lock);
+}
 
-  release(&disk.vdisk_lock);
+// finish the request with descriptor chain head (or buffer id) id.
+static void
+complete(struct disk *d, int id)
+{
+  if(d->info[id].status != 0)
+    panic("virtio_disk_intr status");
+
+  struct buf *b = d->info[id].b;
+  b->disk = 0;   // disk is done with buf
+  wakeup(b);
 }
 
+// is the packed ring slot at used_idx marked used by the device?
+static int
+packed_used(struct disk *d)
+{
+  uint16 flags = d->ring[d->used_idx].flags;
+  int avail = (flags & VRING_PACKED_DESC_F_AVAIL) != 0;
+  int used = (flags & VRING_PACKED_DESC_F_USED) != 0;
+  return avail == used && used == d->used_wrap;
+}
+
+// interrupt from the device in virtio-mmio slot slot.
 void
-virtio_disk_intr()
+virtio_disk_intr(int slot)
 {
-  acquire(&disk.vdisk_lock);
+  struct disk *d = &disks[slot];
+
+  if(d->base == 0)
+    return;
+
+  acquire(&d->vdisk_lock);
 
   // the device won't raise another interrupt until we tell it
   // we've seen this interrupt, which the following line does.
@@ -302,26 +504,41 @@ virtio_disk_intr()
   // the "used" ring, in which case we may process the new
   // completion entries in this interrupt, and have nothing to do
   // in the next interrupt, which is harmless.
-  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+  *R(d, VIRTIO_MMIO_INTERRUPT_ACK) = *R(d, VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
 
   __sync_synchronize();
 
-  // the device increments disk.used->idx when it
-  // adds an entry to the used ring.
-
-  while(disk.used_idx != disk.used->idx){
-    __sync_synchronize();
-    int id = disk.used->ring[disk.used_idx % NUM].id;
+  if(d->packed){
+    // the device writes one used descriptor, in the slot of the
+    // chain's head, for each completed chain; the chain's other
+    // slots are skipped.
+    while(packed_used(d)){
+      __sync_synchronize();
+      int id = d->ring[d->used_idx].id;
+
+      complete(d, id);
+
+      d->used_idx += d->info[id].ndesc;
+      if(d->used_idx >= NUM){
+        d->used_idx -= NUM;
+        d->used_wrap ^= 1;
+      }
+      d->nslots += d->info[id].ndesc;
+      wakeup(&d->free[0]);
+    }
+  } else {
+    // the device increments d->used->idx when it
+    // adds an entry to the used ring.
 
-    if(disk.info[id].status != 0)
-      panic("virtio_disk_intr status");
+    while(d->used_idx != d->used->idx){
+      __sync_synchronize();
+      int id = d->used->ring[d->used_idx % NUM].id;
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+      complete(d, id);
 
-    disk.used_idx += 1;
+      d->used_idx += 1;
+    }
   }
 
-  release(&disk.vdisk_lock);
+  release(&d->vdisk_lock);
 }
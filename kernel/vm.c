@@ -5,6 +5,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "mman.h"
+#include "kstat.h"
 
 /*
  * the kernel's page table.
@@ -15,6 +17,15 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+// page-table pages in use, kernel and user, for meminfo.
+static uint64 nptpages;
+
+uint64
+vmptpages(void)
+{
+  return nptpages;
+}
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -23,12 +34,13 @@ kvmmake(void)
 
   kpgtbl = (pagetable_t) kalloc();
   memset(kpgtbl, 0, PGSIZE);
+  __sync_fetch_and_add(&nptpages, 1);
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
 
-  // virtio mmio disk interface
-  kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
+  // virtio mmio disk interfaces
+  kvmmap(kpgtbl, VIRTIO0, VIRTIO0, NVIRTIO*PGSIZE, PTE_R | PTE_W);
 
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
@@ -37,7 +49,7 @@ kvmmake(void)
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
   // map kernel data and the physical RAM we'll make use of.
-  kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
+  kvmmap(kpgtbl, (uint64)etext, (uint64)etext, phystop-(uint64)etext, PTE_R | PTE_W);
 
   // map the trampoline for trap entry/exit to
   // the highest virtual address in the kernel.
@@ -96,6 +108,7 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
       memset(pagetable, 0, PGSIZE);
+      __sync_fetch_and_add(&nptpages, 1);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -191,6 +204,70 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
   }
 }
 
+// map fresh zeroed pages at the unmapped pages of
+// [start, end), as lazy allocation would on a fault;
+// mapped pages are left alone. returns the number of
+// pages mapped, or -1 if memory ran out.
+int
+uvmprefault(pagetable_t pagetable, uint64 start, uint64 end)
+{
+  uint64 a;
+  pte_t *pte;
+  char *mem;
+  int n = 0;
+
+  for(a = PGROUNDDOWN(start); a < end; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) != 0 && (*pte & PTE_V))
+      continue;
+    if((mem = kalloc()) == 0)
+      return -1;
+    memset(mem, 0, PGSIZE);
+    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_U|PTE_W|PTE_R) != 0){
+      kfree(mem);
+      return -1;
+    }
+    n++;
+  }
+  return n;
+}
+
+// set the user permissions of the pages in [start, end)
+// to prot, a PROT_* combination from mman.h, mapping any
+// lazy pages first. a page shared copy-on-write stays
+// shared when made writable: it gets PTE_COW rather than
+// PTE_W, and the next write copies it. start must be
+// page-aligned. the stale TLB entries are flushed once, by
+// the sfence.vma on the way back to user space.
+// returns 0, or -1 if memory ran out.
+int
+uvmprotect(pagetable_t pagetable, uint64 start, uint64 end, int prot)
+{
+  uint64 a, pa;
+  pte_t *pte;
+  uint perm;
+
+  if(uvmprefault(pagetable, start, end) < 0)
+    return -1;
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      panic("uvmprotect");
+    pa = PTE2PA(*pte);
+    if(prot == PROT_NONE){
+      perm = PTE_R;  // valid, but no PTE_U: every access faults
+    } else {
+      perm = PTE_U;
+      if(prot & (PROT_READ|PROT_WRITE))
+        perm |= PTE_R;
+      if(prot & PROT_EXEC)
+        perm |= PTE_X;
+      if(prot & PROT_WRITE)
+        perm |= get_page_ref(pa) > 1 ? PTE_COW : PTE_W;
+    }
+    *pte = (*pte & ~(PTE_R|PTE_W|PTE_X|PTE_U|PTE_COW)) | perm;
+  }
+  return 0;
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
@@ -201,6 +278,7 @@ uvmcreate()
   if(pagetable == 0)
     return 0;
   memset(pagetable, 0, PGSIZE);
+  __sync_fetch_and_add(&nptpages, 1);
   return pagetable;
 }
 
@@ -281,9 +359,52 @@ freewalk(pagetable_t pagetable)
       pagetable[i] = 0;
     }
   }
+  __sync_fetch_and_sub(&nptpages, 1);
   kfree((void*)pagetable);
 }
 
+// add the mappings in pagetable, a level-level table for the
+// addresses from va, to pm's region counts.
+static void
+statwalk(pagetable_t pagetable, int level, uint64 va, uint64 sz, struct procmem *pm)
+{
+  pm->ptpages++;
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pagetable[i];
+    uint64 a = va + ((uint64)i << PXSHIFT(level));
+    if((pte & PTE_V) == 0)
+      continue;
+    if((pte & (PTE_R|PTE_W|PTE_X)) == 0){
+      statwalk((pagetable_t)PTE2PA(pte), level-1, a, sz, pm);
+      continue;
+    }
+    if(a >= sz)
+      continue;
+    struct pmregion *r = &pm->region[PM_TEXT];
+    for(int j = 0; j < NPMREGION; j++)
+      if(a >= pm->region[j].start && a < pm->region[j].end)
+        r = &pm->region[j];
+    uint64 n = 1L << (9*level);  // pages in this mapping
+    r->resident += n;
+    if(level > 0)
+      r->huge++;
+    if(pte & PTE_COW)
+      r->cow += n;
+    if(get_page_ref(PTE2PA(pte)) > 1)
+      r->shared += n;
+  }
+}
+
+// count the pages of user memory mapped by pagetable, and
+// all its page-table pages, into pm, whose regions' address
+// ranges the caller has set. the trampoline and trapframe
+// pages, above sz, are not user memory.
+void
+uvmstat(pagetable_t pagetable, uint64 sz, struct procmem *pm)
+{
+  statwalk(pagetable, 2, 0, sz, pm);
+}
+
 // Free user memory pages,
 // then free page-table pages.
 void
@@ -335,19 +456,6 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return -1;
 }
 
-// mark a PTE invalid for user access.
-// used by exec for the user stack guard page.
-void
-uvmclear(pagetable_t pagetable, uint64 va)
-{
-  pte_t *pte;
-  
-  pte = walk(pagetable, va, 0);
-  if(pte == 0)
-    panic("uvmclear");
-  *pte &= ~PTE_U;
-}
-
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -374,6 +482,8 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
     
     if ((pa0 = walkaddr(pagetable, va0)) == 0)
       return -1;
+    if ((*walk(pagetable, va0, 0) & PTE_W) == 0)
+      return -1;  // read-only: text, or mprotect()ed
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
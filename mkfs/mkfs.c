@@ -0,0 +1,508 @@
+// Build an xv6 file system image.
+//
+// usage: mkfs [-s size] [-i ninodes] [-l nlog] [-v] fs.img files...
+//
+// Host directories among the files are copied recursively.
+// The layout is planned before anything is written:
+//  - inodes are numbered breadth-first, so the entries of a
+//    directory get consecutive inumbers, near one another in
+//    the inode blocks;
+//  - each directory's data comes just before the data of the
+//    files in it;
+//  - each file's data blocks are contiguous, with its indirect
+//    block, if any, between the last direct block and the
+//    first block it maps, so a sequential read of the file is
+//    a sequential read of the disk;
+//  - a file of at most INLINESIZE bytes is kept in its inode
+//    and takes no blocks.
+// mkfs prints the layout; -v adds a line per file.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define stat xv6_stat  // avoid clash with host struct stat
+#define dirent xv6_dirent  // avoid clash with host struct dirent
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#undef stat
+#undef dirent
+
+#define NINODES 200
+
+// Disk layout:
+// [ boot block | sb block | log | inode blocks | free bit map | orphan block |
+//   refcount map | data blocks ]
+
+int fssize = FSSIZE;
+int ninodes = NINODES;
+int nlog = LOGSIZE;
+int nbitmap;
+int nref;     // Number of refcount map blocks, a byte per block
+int ninodeblocks;
+int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap, orphan, refs)
+int nblocks;  // Number of data blocks
+int verbose;
+
+int fsfd;
+struct superblock sb;
+char zeroes[BSIZE];
+uint freeinode = 1;
+uint freeblock;
+
+// a file or directory to be written to the image.
+struct node {
+  char name[DIRSIZ+1];
+  char *path;                  // host path; 0 for the root
+  short type;                  // T_DIR or T_FILE
+  uint size;                   // bytes
+  uint inum;
+  uint first;                  // first data block
+  uint nblocks;                // data blocks, not counting the indirect block
+  uint indirect;               // indirect block, or 0
+  int inlined;                 // data kept in the inode (DI_INLINE)
+  struct node *parent;
+  struct node *child, *last;   // a directory's entries, in order
+  struct node *next;           // next entry of the parent
+  struct node *qnext;          // breadth-first order
+};
+
+void wsect(uint, void*);
+void winode(uint, struct dinode*);
+void die(const char *);
+
+// convert to riscv byte order
+ushort
+xshort(ushort x)
+{
+  ushort y;
+  uchar *a = (uchar*)&y;
+  a[0] = x;
+  a[1] = x >> 8;
+  return y;
+}
+
+uint
+xint(uint x)
+{
+  uint y;
+  uchar *a = (uchar*)&y;
+  a[0] = x;
+  a[1] = x >> 8;
+  a[2] = x >> 16;
+  a[3] = x >> 24;
+  return y;
+}
+
+void
+usage(void)
+{
+  fprintf(stderr, "Usage: mkfs [-s size] [-i ninodes] [-l nlog] [-v] fs.img files...\n");
+  exit(1);
+}
+
+struct node*
+newnode(struct node *parent, char *name, char *path)
+{
+  struct node *n;
+
+  if(strlen(name) > DIRSIZ){
+    fprintf(stderr, "mkfs: name too long: %s\n", name);
+    exit(1);
+  }
+  n = calloc(1, sizeof(*n));
+  if(n == 0)
+    die("calloc");
+  strcpy(n->name, name);
+  n->path = path;
+  n->type = T_DIR;
+  n->parent = parent;
+  if(parent){
+    if(parent->last)
+      parent->last->next = n;
+    else
+      parent->child = n;
+    parent->last = n;
+  }
+  return n;
+}
+
+int
+namecmp(const void *a, const void *b)
+{
+  return strcmp(*(char**)a, *(char**)b);
+}
+
+// add host file or directory path to directory parent, as name.
+void
+addpath(struct node *parent, char *name, char *path)
+{
+  struct stat st;
+  struct node *n;
+  struct dirent *de;
+  DIR *d;
+  char **names = 0;
+  int nnames = 0, i;
+
+  for(n = parent->child; n; n = n->next){
+    if(strcmp(n->name, name) == 0){
+      fprintf(stderr, "mkfs: duplicate name %s\n", name);
+      exit(1);
+    }
+  }
+  if(stat(path, &st) < 0)
+    die(path);
+  n = newnode(parent, name, path);
+  if(!S_ISDIR(st.st_mode)){
+    n->type = T_FILE;
+    n->size = st.st_size;
+    return;
+  }
+
+  // add the entries in name order, so images are reproducible.
+  if((d = opendir(path)) == 0)
+    die(path);
+  while((de = readdir(d)) != 0){
+    if(strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+    names = realloc(names, (nnames + 1) * sizeof(char*));
+    if(names == 0)
+      die("realloc");
+    names[nnames++] = strdup(de->d_name);
+  }
+  closedir(d);
+  qsort(names, nnames, sizeof(char*), namecmp);
+  for(i = 0; i < nnames; i++){
+    char *sub = malloc(strlen(path) + strlen(names[i]) + 2);
+    if(sub == 0)
+      die("malloc");
+    sprintf(sub, "%s/%s", path, names[i]);
+    addpath(n, names[i], sub);
+  }
+  free(names);
+}
+
+// choose n's data blocks: the next nblocks free ones, with
+// the indirect block after the NDIRECT'th.
+void
+place(struct node *n)
+{
+  int nentries = 2;
+  struct node *c;
+
+  if(n->type == T_DIR){
+    for(c = n->child; c; c = c->next)
+      nentries++;
+    n->size = nentries * sizeof(struct xv6_dirent);
+  } else if(n->size > 0 && n->size <= INLINESIZE){
+    n->inlined = 1;
+    return;
+  }
+  n->nblocks = (n->size + BSIZE - 1) / BSIZE;
+  if(n->nblocks > MAXFILE){
+    fprintf(stderr, "mkfs: %s is too big\n", n->path);
+    exit(1);
+  }
+  n->first = freeblock;
+  freeblock += n->nblocks;
+  if(n->nblocks > NDIRECT){
+    n->indirect = n->first + NDIRECT;
+    freeblock++;
+  }
+  if(freeblock > fssize){
+    fprintf(stderr, "mkfs: out of blocks; try a bigger -s\n");
+    exit(1);
+  }
+}
+
+// block number of n's i'th data block.
+uint
+bmap(struct node *n, uint i)
+{
+  if(i < NDIRECT || n->indirect == 0)
+    return n->first + i;
+  return n->first + i + 1;
+}
+
+// write n's inode, data and indirect block.
+void
+writenode(struct node *n)
+{
+  struct dinode din;
+  struct xv6_dirent de;
+  struct node *c;
+  char buf[BSIZE];
+  uint indirect[NINDIRECT];
+  uint i, off;
+  int fd = -1, nlink = 1;
+
+  // a directory is also linked from each subdirectory's "..",
+  // as the kernel counts it.
+  for(c = n->child; c; c = c->next)
+    if(c->type == T_DIR)
+      nlink++;
+
+  bzero(&din, sizeof(din));
+  din.type = xshort(n->type);
+  din.nlink = xshort(nlink);
+  din.size = xint(n->size);
+  for(i = 0; i < n->nblocks && i < NDIRECT; i++)
+    din.addrs[i] = xint(bmap(n, i));
+  if(n->indirect){
+    din.addrs[NDIRECT] = xint(n->indirect);
+    bzero(indirect, sizeof(indirect));
+    for(i = NDIRECT; i < n->nblocks; i++)
+      indirect[i - NDIRECT] = xint(bmap(n, i));
+    wsect(n->indirect, indirect);
+  }
+  if(n->type == T_FILE && (fd = open(n->path, 0)) < 0)
+    die(n->path);
+  if(n->inlined){
+    din.flags = xshort(DI_INLINE);
+    if(read(fd, din.addrs, n->size) != n->size)
+      die(n->path);
+  }
+  winode(n->inum, &din);
+
+  for(i = 0; i < n->nblocks; i++){
+    bzero(buf, sizeof(buf));
+    if(n->type == T_FILE){
+      if(read(fd, buf, BSIZE) < 0)
+        die(n->path);
+    } else {
+      // ".", "..", then the entries; dirents don't span blocks.
+      for(off = 0; off < BSIZE; off += sizeof(de)){
+        uint e = (i * BSIZE + off) / sizeof(de);
+        bzero(&de, sizeof(de));
+        if(e == 0){
+          de.inum = xshort(n->inum);
+          strcpy(de.name, ".");
+        } else if(e == 1){
+          de.inum = xshort(n->parent ? n->parent->inum : n->inum);
+          strcpy(de.name, "..");
+        } else {
+          for(c = n->child; c && e > 2; c = c->next)
+            e--;
+          if(c == 0)
+            break;
+          de.inum = xshort(c->inum);
+          strncpy(de.name, c->name, DIRSIZ);
+        }
+        memmove(buf + off, &de, sizeof(de));
+      }
+    }
+    wsect(bmap(n, i), buf);
+  }
+  if(fd >= 0)
+    close(fd);
+}
+
+// mark blocks [0, used) allocated in the free bitmap.
+void
+balloc(int used)
+{
+  uchar buf[BSIZE];
+  int i, b;
+
+  for(b = 0; b < nbitmap; b++){
+    bzero(buf, BSIZE);
+    for(i = 0; i < BPB && b*BPB + i < used; i++)
+      buf[i/8] = buf[i/8] | (0x1 << (i%8));
+    wsect(sb.bmapstart + b, buf);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, opt;
+  uint nfiles = 0, ndirs = 0, nindirect = 0, ninline = 0;
+  struct node *root, *n, *c, *head, *tail;
+
+  static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
+  assert((BSIZE % sizeof(struct dinode)) == 0);
+  assert((BSIZE % sizeof(struct xv6_dirent)) == 0);
+
+  while((opt = getopt(argc, argv, "s:i:l:v")) != -1){
+    switch(opt){
+    case 's': fssize = atoi(optarg); break;
+    case 'i': ninodes = atoi(optarg); break;
+    case 'l': nlog = atoi(optarg); break;
+    case 'v': verbose = 1; break;
+    default: usage();
+    }
+  }
+  if(argc - optind < 1)
+    usage();
+  // the kernel's log holds at most LOGSIZE blocks, pinned in
+  // the buffer cache, plus the header, and needs room for at
+  // least one whole operation.
+  if(nlog < MAXOPBLOCKS + 1 || nlog > LOGSIZE + 1){
+    fprintf(stderr, "mkfs: nlog must be between %d and %d\n", MAXOPBLOCKS + 1, LOGSIZE + 1);
+    exit(1);
+  }
+  if(ninodes < 2 || ninodes > 65535){
+    fprintf(stderr, "mkfs: ninodes must be between 2 and 65535\n");
+    exit(1);
+  }
+
+  nbitmap = fssize/BPB + 1;
+  ninodeblocks = ninodes / IPB + 1;
+  nref = fssize/BSIZE + 1;
+  nmeta = 2 + nlog + ninodeblocks + nbitmap + 1 + nref;
+  nblocks = fssize - nmeta;
+  if(nblocks <= 0){
+    fprintf(stderr, "mkfs: size %d is too small\n", fssize);
+    exit(1);
+  }
+
+  sb.magic = FSMAGIC;
+  sb.size = xint(fssize);
+  sb.nblocks = xint(nblocks);
+  sb.ninodes = xint(ninodes);
+  sb.nlog = xint(nlog);
+  sb.logstart = xint(2);
+  sb.inodestart = xint(2+nlog);
+  sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.orphanstart = xint(2+nlog+ninodeblocks+nbitmap);
+  sb.refstart = xint(2+nlog+ninodeblocks+nbitmap+1);
+
+  // gather the files.
+  root = newnode(0, "/", 0);
+  for(i = optind + 1; i < argc; i++){
+    char *shortname;
+    if(strncmp(argv[i], "user/", 5) == 0)
+      shortname = argv[i] + 5;
+    else
+      shortname = argv[i];
+
+    assert(index(shortname, '/') == 0);
+
+    // Skip leading _ in name when writing to file system.
+    // The binaries are named _rm, _cat, etc. to keep the
+    // build operating system from trying to execute them
+    // in place of system binaries like rm and cat.
+    if(shortname[0] == '_')
+      shortname += 1;
+
+    addpath(root, shortname, argv[i]);
+  }
+
+  // number the inodes breadth-first, then place the data of
+  // each directory and then of its files, in the same order.
+  freeinode = ROOTINO;
+  root->inum = freeinode++;
+  freeblock = nmeta;
+  head = tail = root;
+  for(n = head; n; n = n->qnext){
+    place(n);
+    for(c = n->child; c; c = c->next){
+      if(freeinode >= ninodes){
+        fprintf(stderr, "mkfs: out of inodes; try a bigger -i\n");
+        exit(1);
+      }
+      c->inum = freeinode++;
+    }
+    for(c = n->child; c; c = c->next){
+      if(c->type == T_FILE)
+        place(c);
+      else {
+        tail->qnext = c;
+        tail = c;
+      }
+    }
+  }
+
+  fsfd = open(argv[optind], O_RDWR|O_CREAT|O_TRUNC, 0666);
+  if(fsfd < 0)
+    die(argv[optind]);
+
+  for(i = 0; i < fssize; i++)
+    wsect(i, zeroes);
+
+  char buf[BSIZE];
+  memset(buf, 0, sizeof(buf));
+  memmove(buf, &sb, sizeof(sb));
+  wsect(1, buf);
+
+  for(n = head; n; n = n->qnext){
+    ndirs++;
+    writenode(n);
+    for(c = n->child; c; c = c->next){
+      if(c->type == T_FILE){
+        nfiles++;
+        writenode(c);
+      }
+    }
+  }
+  balloc(freeblock);
+
+  printf("mkfs: %d blocks: boot 1, super 1, log %d at 2, inodes %d at %d, "
+         "bitmap %d at %d, orphans 1 at %d, refs %d at %d, data %d at %d\n",
+         fssize, nlog, ninodeblocks, 2+nlog, nbitmap, 2+nlog+ninodeblocks,
+         nmeta-nref-1, nref, nmeta-nref, nblocks, nmeta);
+
+  for(n = head; n; n = n->qnext){
+    for(c = n; c; c = (c == n ? n->child : c->next)){
+      if(c != n && c->type == T_DIR)
+        continue;
+      if(c->indirect)
+        nindirect++;
+      if(c->inlined)
+        ninline++;
+      if(verbose && c->inlined)
+        printf("  inode %3d file %8d bytes  inline  %s\n", c->inum, c->size, c->path);
+      else if(verbose && c->nblocks > 0)
+        printf("  inode %3d %s %8d bytes  blocks %d-%d%s  %s\n", c->inum,
+               c->type == T_DIR ? "dir " : "file", c->size, c->first,
+               c->first + c->nblocks - (c->indirect ? 0 : 1),
+               c->indirect ? " (indirect inside)" : "", c->path ? c->path : "/");
+    }
+  }
+  printf("mkfs: %d directories, %d files, inodes 1-%d of %d; data blocks %d-%d "
+         "used of %d, each file contiguous, %d with an indirect block, %d inline\n",
+         ndirs, nfiles, freeinode - 1, ninodes, nmeta, freeblock - 1, nblocks,
+         nindirect, ninline);
+
+  exit(0);
+}
+
+void
+wsect(uint sec, void *buf)
+{
+  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
+    die("lseek");
+  if(write(fsfd, buf, BSIZE) != BSIZE)
+    die("write");
+}
+
+void
+winode(uint inum, struct dinode *ip)
+{
+  char buf[BSIZE];
+  uint bn;
+  struct dinode *dip;
+
+  bn = IBLOCK(inum, sb);
+  if(lseek(fsfd, bn * BSIZE, 0) != bn * BSIZE)
+    die("lseek");
+  if(read(fsfd, buf, BSIZE) != BSIZE)
+    die("read");
+  dip = ((struct dinode*)buf) + (inum % IPB);
+  *dip = *ip;
+  wsect(bn, buf);
+}
+
+void
+die(const char *s)
+{
+  perror(s);
+  exit(1);
+}
@@ -0,0 +1,74 @@
+// Split a file system image into the member images of a
+// RAID-0 set, using the same layout as kernel/stripe.c.
+//
+// usage: stripe fs.img n
+// writes fs.img.0 ... fs.img.<n-1>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define stat xv6_stat  // avoid clash with host struct stat
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+
+void
+die(const char *s)
+{
+  perror(s);
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int in, n, i;
+  int out[NVIRTIO];
+  char name[256];
+  uchar buf[BSIZE];
+  uint b, unit, nunits;
+
+  if(argc != 3){
+    fprintf(stderr, "Usage: stripe fs.img n\n");
+    exit(1);
+  }
+  n = atoi(argv[2]);
+  if(n < 1 || n > NVIRTIO){
+    fprintf(stderr, "stripe: n must be between 1 and %d\n", NVIRTIO);
+    exit(1);
+  }
+
+  in = open(argv[1], O_RDONLY);
+  if(in < 0)
+    die(argv[1]);
+
+  for(i = 0; i < n; i++){
+    snprintf(name, sizeof(name), "%s.%d", argv[1], i);
+    out[i] = open(name, O_RDWR|O_CREAT|O_TRUNC, 0666);
+    if(out[i] < 0)
+      die(name);
+  }
+
+  for(b = 0; read(in, buf, BSIZE) == BSIZE; b++){
+    unit = b / STRIPEBLOCKS;
+    off_t off = ((off_t)(unit / n) * STRIPEBLOCKS + b % STRIPEBLOCKS) * BSIZE;
+    if(pwrite(out[unit % n], buf, BSIZE, off) != BSIZE)
+      die("write");
+  }
+
+  // make every member the same size: enough whole stripe
+  // units to cover the image.
+  nunits = (b + STRIPEBLOCKS*n - 1) / (STRIPEBLOCKS*n);
+  for(i = 0; i < n; i++){
+    if(ftruncate(out[i], (off_t)nunits * STRIPEBLOCKS * BSIZE) < 0)
+      die("ftruncate");
+    close(out[i]);
+  }
+  close(in);
+  exit(0);
+}
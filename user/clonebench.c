@@ -0,0 +1,129 @@
+//
+// clonebench [-k KiB]: copy a file by reading and writing it,
+// then by clone(), and report the time and disk blocks written
+// by each; then write one block of the clone and check that the
+// source still holds its own data.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+static char buf[BSIZE];
+
+static void
+fill(char *name, int nblocks)
+{
+  int fd, i;
+
+  if((fd = open(name, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    printf("clonebench: cannot create %s\n", name);
+    exit(1);
+  }
+  for(i = 0; i < nblocks; i++){
+    memset(buf, 'a' + i % 26, BSIZE);
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("clonebench: write %s failed\n", name);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+static void
+copy(char *from, char *to)
+{
+  int in, out, n;
+
+  if((in = open(from, O_RDONLY)) < 0 || (out = open(to, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    printf("clonebench: cannot copy %s\n", from);
+    exit(1);
+  }
+  while((n = read(in, buf, BSIZE)) > 0){
+    if(write(out, buf, n) != n){
+      printf("clonebench: write %s failed\n", to);
+      exit(1);
+    }
+  }
+  close(in);
+  close(out);
+}
+
+static void
+report(char *what, uint64 us, struct kstat *k0, struct kstat *k1)
+{
+  printf("%s\t%d\t%d\t%d\n", what, (int)us,
+         (int)(k1->ndiskread - k0->ndiskread),
+         (int)(k1->ndiskwrite - k0->ndiskwrite));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct kstat k0, k1;
+  uint64 t0;
+  int kib = 256, nblocks, fd;
+
+  if(argc == 3 && strcmp(argv[1], "-k") == 0)
+    kib = atoi(argv[2]);
+  else if(argc != 1){
+    printf("usage: clonebench [-k KiB]\n");
+    exit(1);
+  }
+  nblocks = kib * 1024 / BSIZE;
+  if(nblocks < 1 || nblocks > MAXFILE){
+    printf("clonebench: size must be between %d and %d KiB\n",
+           BSIZE / 1024, MAXFILE * BSIZE / 1024);
+    exit(1);
+  }
+  fill("cb.src", nblocks);
+  unlink("cb.copy");
+  unlink("cb.clone");
+
+  printf("%d KiB file\n", nblocks * BSIZE / 1024);
+  printf("method\tus\treads\twrites\n");
+  kstat(&k0);
+  t0 = uptimeus();
+  copy("cb.src", "cb.copy");
+  t0 = uptimeus() - t0;
+  kstat(&k1);
+  report("copy", t0, &k0, &k1);
+
+  kstat(&k0);
+  t0 = uptimeus();
+  if(clone("cb.src", "cb.clone") < 0){
+    printf("clonebench: clone failed\n");
+    exit(1);
+  }
+  t0 = uptimeus() - t0;
+  kstat(&k1);
+  report("clone", t0, &k0, &k1);
+
+  // the first write to a shared block copies it.
+  memset(buf, 'z', BSIZE);
+  kstat(&k0);
+  t0 = uptimeus();
+  if((fd = open("cb.clone", O_WRONLY)) < 0 || write(fd, buf, BSIZE) != BSIZE){
+    printf("clonebench: write cb.clone failed\n");
+    exit(1);
+  }
+  close(fd);
+  t0 = uptimeus() - t0;
+  kstat(&k1);
+  report("cow 1blk", t0, &k0, &k1);
+
+  if((fd = open("cb.src", O_RDONLY)) < 0 || read(fd, buf, BSIZE) != BSIZE || buf[0] != 'a'){
+    printf("clonebench: source changed by a write to its clone\n");
+    exit(1);
+  }
+  close(fd);
+
+  unlink("cb.src");
+  unlink("cb.copy");
+  unlink("cb.clone");
+  exit(0);
+}
@@ -0,0 +1,183 @@
+//
+// compressbench [-k KiB]: write a file of log-like text, and
+// one of random bytes, both plain and with O_COMPRESS, and read
+// each back; report the disk blocks each takes, the compression
+// ratio, and the write and read throughput and disk blocks
+// moved. the files are read right after being written, so most
+// of a plain file's blocks come from the buffer cache, while a
+// compressed file's clusters are decompressed again unless
+// still in the kernel's small cluster cache.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+#define CHUNK CLUSTERSIZE
+
+static char buf[CHUNK], back[CHUNK];
+static uint seed = 1;
+
+static uint
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static char*
+putnum(char *p, uint n, int width)
+{
+  char s[10];
+  int i = 0;
+
+  do {
+    s[i++] = '0' + n % 10;
+    n /= 10;
+  } while(n > 0 || i < width);
+  while(i > 0)
+    *p++ = s[--i];
+  return p;
+}
+
+// fill buf with the bytes of the file at off: lines of a log,
+// or random bytes.
+static void
+gen(int text, uint off)
+{
+  static char *level[] = { "INFO ", "INFO ", "INFO ", "WARN ", "DEBUG" };
+  static char *what[] = { "served from cache", "served from disk",
+                          "queued", "retried after timeout" };
+  char line[96], *p, *w;
+  int i, n, len;
+
+  seed = off + 1;
+  if(!text){
+    for(i = 0; i < CHUNK; i++)
+      buf[i] = rnd();
+    return;
+  }
+  for(i = 0; i < CHUNK; i += n){
+    p = line;
+    memmove(p, "2026-10-18 12:", 14);
+    p = putnum(p + 14, (off + i) / 4000 % 60, 2);
+    *p++ = ':';
+    p = putnum(p, (off + i) / 100 % 60, 2);
+    *p++ = ' ';
+    memmove(p, level[rnd() % 5], 5);
+    p += 5;
+    memmove(p, " request ", 9);
+    p = putnum(p + 9, rnd() % 100000, 1);
+    *p++ = ' ';
+    w = what[rnd() % 4];
+    len = strlen(w);
+    memmove(p, w, len);
+    p += len;
+    memmove(p, " in ", 4);
+    p = putnum(p + 4, rnd() % 200, 1);
+    memmove(p, " ms\n", 4);
+    p += 4;
+    n = p - line;
+    if(n > CHUNK - i)
+      n = CHUNK - i;
+    memmove(buf + i, line, n);
+  }
+}
+
+// KiB/s for kib KiB in us microseconds.
+static int
+rate(int kib, uint64 us)
+{
+  return us ? (int)(kib * 1000000ULL / us) : 0;
+}
+
+static void
+run(int text, int compress, int kib)
+{
+  char *name = compress ? "cb.z" : "cb.plain";
+  struct kstat k0, k1, k2;
+  struct stat st;
+  uint64 t0, t1, t2;
+  uint off, size = kib * 1024;
+  int fd;
+
+  unlink(name);
+  kstat(&k0);
+  t0 = uptimeus();
+  fd = open(name, O_CREATE|O_TRUNC|O_WRONLY|(compress ? O_COMPRESS : 0));
+  if(fd < 0){
+    printf("compressbench: cannot create %s\n", name);
+    exit(1);
+  }
+  for(off = 0; off < size; off += CHUNK){
+    gen(text, off);
+    if(write(fd, buf, CHUNK) != CHUNK){
+      printf("compressbench: write %s failed\n", name);
+      exit(1);
+    }
+  }
+  close(fd);
+  t1 = uptimeus();
+  kstat(&k1);
+
+  if((fd = open(name, O_RDONLY)) < 0){
+    printf("compressbench: cannot open %s\n", name);
+    exit(1);
+  }
+  for(off = 0; off < size; off += CHUNK){
+    if(read(fd, back, CHUNK) != CHUNK){
+      printf("compressbench: read %s failed\n", name);
+      exit(1);
+    }
+    gen(text, off);
+    if(memcmp(buf, back, CHUNK) != 0){
+      printf("compressbench: %s differs at %d\n", name, off);
+      exit(1);
+    }
+  }
+  t2 = uptimeus();
+  kstat(&k2);
+  if(fstat(fd, &st) < 0){
+    printf("compressbench: cannot stat %s\n", name);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+
+  // the generator's time is counted in both.
+  printf("%s\t%s\t%d\t%d.%d\t%d\t%d\t%d\t%d\n",
+         text ? "text" : "random", compress ? "yes" : "no", st.blocks,
+         size / BSIZE / st.blocks, size / BSIZE * 10 / st.blocks % 10,
+         rate(kib, t1 - t0), (int)(k1.ndiskwrite - k0.ndiskwrite),
+         rate(kib, t2 - t1), (int)(k2.ndiskread - k1.ndiskread));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kib = 256;
+
+  if(argc == 3 && strcmp(argv[1], "-k") == 0)
+    kib = atoi(argv[2]);
+  else if(argc != 1){
+    printf("usage: compressbench [-k KiB]\n");
+    exit(1);
+  }
+  if(kib < CHUNK / 1024 || kib > MAXFILE * BSIZE / 1024 || kib % (CHUNK / 1024) != 0){
+    printf("compressbench: size must be a multiple of %d KiB up to %d KiB\n",
+           CHUNK / 1024, MAXFILE * BSIZE / 1024);
+    exit(1);
+  }
+
+  printf("%d KiB files, %d KiB clusters\n", kib, CLUSTERSIZE / 1024);
+  printf("data\tcompr\tblocks\tratio\twr KiB/s\twrites\trd KiB/s\treads\n");
+  run(1, 0, kib);
+  run(1, 1, kib);
+  run(0, 0, kib);
+  run(0, 1, kib);
+  exit(0);
+}
@@ -0,0 +1,72 @@
+//
+// exec latency benchmark.
+//
+// execbench [n [nargs]]: fork and exec a trivial program n
+// times with nargs (default MAXARG) 64-byte arguments, and
+// report the average time per fork+exec+exit+wait.
+//
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define ARGLEN 64
+
+static char argbuf[MAXARG][ARGLEN];
+
+int
+main(int argc, char *argv[])
+{
+  char *args[MAXARG+1];
+  int i, n, nargs, pid, xstatus, start, ticks;
+
+  // the child: exit as soon as exec() has delivered the arguments.
+  if(argc > 1 && strcmp(argv[1], "-x") == 0){
+    for(i = 2; i < argc; i++){
+      if(strlen(argv[i]) != ARGLEN-1)
+        exit(1);
+    }
+    exit(0);
+  }
+
+  n = argc > 1 ? atoi(argv[1]) : 200;
+  nargs = argc > 2 ? atoi(argv[2]) : MAXARG;
+  if(n < 1 || nargs < 2 || nargs > MAXARG){
+    printf("usage: execbench [n [nargs]], 2 <= nargs <= %d\n", MAXARG);
+    exit(1);
+  }
+
+  args[0] = "execbench";
+  args[1] = "-x";
+  for(i = 2; i < nargs; i++){
+    memset(argbuf[i], 'a' + i % 26, ARGLEN-1);
+    argbuf[i][ARGLEN-1] = 0;
+    args[i] = argbuf[i];
+  }
+  args[nargs] = 0;
+
+  start = uptime();
+  for(i = 0; i < n; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("execbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec("execbench", args);
+      printf("execbench: exec failed\n");
+      exit(1);
+    }
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("execbench: child saw bad arguments\n");
+      exit(1);
+    }
+  }
+  ticks = uptime() - start;
+
+  printf("execbench: %d execs with %d arguments in %d ticks\n", n, nargs, ticks);
+  if(ticks > 0)
+    printf("execbench: %d execs per tick\n", n / ticks);
+  exit(0);
+}
@@ -0,0 +1,51 @@
+//
+// free: physical memory usage, in pages and KiB.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+static void
+row(char *name, uint64 pages)
+{
+  printf("%s\t%d\t%d\n", name, (int)pages, (int)(pages * (PGSIZE / 1024)));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct meminfo mi;
+  char name[16];
+  int i;
+
+  if(meminfo(&mi) < 0){
+    printf("free: meminfo failed\n");
+    exit(1);
+  }
+
+  printf("\tpages\tKiB\n");
+  row("total", mi.total);
+  row("used", mi.total - mi.free);
+  row("free", mi.free);
+  for(i = 0; i < NNUMA; i++){
+    if(mi.nodefree[i] == 0)
+      continue;
+    strcpy(name, "node0");
+    name[4] = '0' + i;
+    row(name, mi.nodefree[i]);
+  }
+  for(i = 0; i < NCPU; i++){
+    if(mi.cpufree[i] == 0)
+      continue;
+    strcpy(name, "cpu0");
+    name[3] = '0' + i;
+    row(name, mi.cpufree[i]);
+  }
+  row("cow", mi.cowshared);
+  row("pgtbl", mi.ptpages);
+  row("bcache", mi.bufpages);
+  exit(0);
+}
@@ -0,0 +1,312 @@
+//
+// file system benchmark, in the style of fio.
+//
+// fsbench [-b bs] [-s size] [-j jobs] [-n ops] [-rand] [-w pct]
+//         [-ordered] [-sync]
+//   each of jobs processes lays out a file of size bytes, then
+//   does ops I/Os of bs bytes to it, sequentially (wrapping at
+//   the end of the file) or at random bs-aligned offsets; pct
+//   percent of them are writes and the rest reads. -ordered
+//   runs with file data written in place instead of through the
+//   log (see datamode()); -sync fsync()s at the end of the
+//   measured phase.
+// fsbench -meta nfiles [-j jobs]
+//   each job creates nfiles empty files, then unlinks them.
+//
+// reports throughput, IOPS and a log2 latency histogram, timed
+// with uptimeus(); laying out the files is not timed. files go
+// in the current directory, so "cd /tmp; /fsbench" measures the
+// RAM disk.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define MAXJOBS 8
+#define MAXBS (8*BSIZE)
+#define NBUCKET 24   // bucket b holds latencies in [2^b, 2^(b+1)) us
+
+enum { RD, WR };     // for -meta: creates and unlinks
+
+struct result {
+  uint64 us;         // time the measured phase took
+  uint64 bytes[2];
+  uint ops[2];
+  uint hist[2][NBUCKET];
+};
+
+static char buf[MAXBS];
+static unsigned long rand_next;
+
+static int
+rand(void)
+{
+  rand_next = rand_next * 1103515245 + 12345;
+  return (rand_next / 65536) % 32768;
+}
+
+static int
+bucket(uint64 us)
+{
+  int b = 0;
+
+  while(b < NBUCKET-1 && us >= (2UL << b))
+    b++;
+  return b;
+}
+
+static void
+record(struct result *r, int rw, uint64 start, int bytes)
+{
+  r->ops[rw]++;
+  r->bytes[rw] += bytes;
+  r->hist[rw][bucket(uptimeus() - start)]++;
+}
+
+static void
+jobname(char *name, int job, int i)
+{
+  strcpy(name, "fsb0.000");
+  name[3] = '0' + job;
+  name[5] = '0' + (i / 100) % 10;
+  name[6] = '0' + (i / 10) % 10;
+  name[7] = '0' + i % 10;
+}
+
+static void
+iojob(int job, struct result *r, int bs, int size, int nops, int random, int wpct,
+      int sync)
+{
+  char name[12];
+  int fd, i, rw, nblocks = size / bs, blk = 0;
+  uint64 start, t0;
+
+  jobname(name, job, 0);
+  if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+    printf("fsbench: cannot create %s\n", name);
+    exit(1);
+  }
+  for(i = 0; i < nblocks; i++){
+    if(write(fd, buf, bs) != bs){
+      printf("fsbench: layout of %s failed\n", name);
+      exit(1);
+    }
+  }
+
+  lseek(fd, 0, SEEK_SET);
+  t0 = uptimeus();
+  for(i = 0; i < nops; i++){
+    if(random){
+      blk = rand() % nblocks;
+      lseek(fd, blk * bs, SEEK_SET);
+    } else if(blk == nblocks){
+      blk = 0;
+      lseek(fd, 0, SEEK_SET);
+    }
+    rw = rand() % 100 < wpct ? WR : RD;
+    start = uptimeus();
+    if((rw == WR ? write(fd, buf, bs) : read(fd, buf, bs)) != bs){
+      printf("fsbench: %s of %s failed\n", rw == WR ? "write" : "read", name);
+      exit(1);
+    }
+    record(r, rw, start, bs);
+    blk++;
+  }
+  if(sync && fsync(fd) < 0){
+    printf("fsbench: fsync of %s failed\n", name);
+    exit(1);
+  }
+  r->us = uptimeus() - t0;
+  close(fd);
+  unlink(name);
+}
+
+static void
+metajob(int job, struct result *r, int nfiles)
+{
+  char name[12];
+  uint64 start, t0 = uptimeus();
+  int i, fd;
+
+  for(i = 0; i < nfiles; i++){
+    jobname(name, job, i);
+    start = uptimeus();
+    if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+      printf("fsbench: cannot create %s\n", name);
+      exit(1);
+    }
+    close(fd);
+    record(r, RD, start, 0);
+  }
+  for(i = 0; i < nfiles; i++){
+    jobname(name, job, i);
+    start = uptimeus();
+    if(unlink(name) < 0){
+      printf("fsbench: cannot unlink %s\n", name);
+      exit(1);
+    }
+    record(r, WR, start, 0);
+  }
+  r->us = uptimeus() - t0;
+}
+
+static int
+readall(int fd, void *dst, int n)
+{
+  int got = 0, cc;
+
+  while(got < n && (cc = read(fd, (char*)dst + got, n - got)) > 0)
+    got += cc;
+  return got;
+}
+
+static int
+percentile(uint *h, uint n, int pct)
+{
+  uint seen = 0;
+
+  for(int b = 0; b < NBUCKET; b++){
+    seen += h[b];
+    if(seen * 100 >= n * pct)
+      return 2 << b;
+  }
+  return 2 << (NBUCKET-1);
+}
+
+static void
+report(struct result *r, uint64 us, char *names[2])
+{
+  int rw, b, lo = NBUCKET, hi = -1;
+
+  if(us == 0)
+    us = 1;
+  for(rw = 0; rw < 2; rw++){
+    if(r->ops[rw] == 0)
+      continue;
+    printf("%s: %d ops, %d IOPS", names[rw], r->ops[rw],
+           (int)(r->ops[rw] * 1000000UL / us));
+    if(r->bytes[rw])
+      printf(", %d KiB/s", (int)(r->bytes[rw] * 1000000UL / us / 1024));
+    printf(", latency p50 %d us, p99 %d us\n",
+           percentile(r->hist[rw], r->ops[rw], 50),
+           percentile(r->hist[rw], r->ops[rw], 99));
+    for(b = 0; b < NBUCKET; b++){
+      if(r->hist[rw][b] == 0)
+        continue;
+      if(b < lo)
+        lo = b;
+      if(b > hi)
+        hi = b;
+    }
+  }
+
+  printf("latency us\t%s\t%s\n", names[RD], names[WR]);
+  for(b = lo; b <= hi; b++)
+    printf("<%d\t\t%d\t%d\n", 2 << b, r->hist[RD][b], r->hist[WR][b]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int bs = BSIZE, size = 128*1024, njobs = 1, nops = 0, random = 0;
+  int wpct = 0, meta = 0, ordered = 0, sync = 0, oldmode = 0;
+  int fds[MAXJOBS], p[2], i, j, b, rw, pid;
+  static struct result sum, r;
+  char *rwnames[2] = { "read", "write" }, *metanames[2] = { "create", "unlink" };
+  uint64 us = 0;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-rand") == 0)
+      random = 1;
+    else if(strcmp(argv[i], "-ordered") == 0)
+      ordered = 1;
+    else if(strcmp(argv[i], "-sync") == 0)
+      sync = 1;
+    else if(i+1 >= argc)
+      goto usage;
+    else if(strcmp(argv[i], "-b") == 0)
+      bs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-s") == 0)
+      size = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-j") == 0)
+      njobs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-n") == 0)
+      nops = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-w") == 0)
+      wpct = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-meta") == 0)
+      meta = atoi(argv[++i]);
+    else
+      goto usage;
+  }
+  if(bs < 1 || bs > MAXBS || size < bs || size > MAXFILE*BSIZE ||
+     njobs < 1 || njobs > MAXJOBS || wpct < 0 || wpct > 100 ||
+     meta < 0 || meta > 1000)
+    goto usage;
+  if(nops == 0)
+    nops = 4 * (size / bs);
+
+  if(meta)
+    printf("fsbench: %d jobs, %d files each\n", njobs, meta);
+  else
+    printf("fsbench: %d jobs, %d-byte %s I/O to %d-byte files, %d%% writes, %d ops each\n",
+           njobs, bs, random ? "random" : "sequential", size, wpct, nops);
+  printf("fsbench: %s data%s\n", ordered ? "ordered" : "journaled",
+         sync ? ", fsync at the end" : "");
+  if(ordered)
+    oldmode = datamode(DATA_ORDERED);
+
+  for(j = 0; j < njobs; j++){
+    if(pipe(p) < 0 || (pid = fork()) < 0){
+      printf("fsbench: cannot start job %d\n", j);
+      exit(1);
+    }
+    if(pid == 0){
+      close(p[0]);
+      rand_next = j + 1;
+      memset(&r, 0, sizeof(r));
+      if(meta)
+        metajob(j, &r, meta);
+      else
+        iojob(j, &r, bs, size, nops, random, wpct, sync);
+      write(p[1], &r, sizeof(r));
+      exit(0);
+    }
+    close(p[1]);
+    fds[j] = p[0];
+  }
+
+  for(j = 0; j < njobs; j++){
+    if(readall(fds[j], &r, sizeof(r)) != sizeof(r)){
+      printf("fsbench: job %d failed\n", j);
+      exit(1);
+    }
+    close(fds[j]);
+    if(r.us > us)
+      us = r.us;  // the jobs ran concurrently
+    for(rw = 0; rw < 2; rw++){
+      sum.ops[rw] += r.ops[rw];
+      sum.bytes[rw] += r.bytes[rw];
+      for(b = 0; b < NBUCKET; b++)
+        sum.hist[rw][b] += r.hist[rw][b];
+    }
+  }
+  for(j = 0; j < njobs; j++)
+    wait(0);
+  if(ordered)
+    datamode(oldmode);
+
+  printf("fsbench: %d ms\n", (int)(us / 1000));
+  report(&sum, us, meta ? metanames : rwnames);
+  exit(0);
+
+usage:
+  printf("usage: fsbench [-b bs] [-s size] [-j jobs] [-n ops] [-rand] [-w pct]\n");
+  printf("               [-ordered] [-sync]\n");
+  printf("       fsbench -meta nfiles [-j jobs]\n");
+  exit(1);
+}
@@ -0,0 +1,172 @@
+//
+// write-barrier benchmark, in the style of a generational
+// garbage collector's card marking.
+//
+// a mutator stores pointers into random pages of a heap, and
+// every round the collector scans and clears the card table,
+// which records the pages written since the last round.
+//   soft:  every store also marks its card in software.
+//   fault: the heap is mprotect()ed read-only after each
+//          round; the first store to a page faults, and the
+//          sigsegv() handler marks the card and makes that
+//          page writable again.
+// the fault barrier makes stores free at the price of one
+// fault per dirtied page per round, so it wins when stores
+// are many and the pages they hit are few.
+//
+// gcbench [nstores [hotpages]]: hotpages is the number of
+// heap pages the stores land in.
+//
+// finally checks that a read-only page shared copy-on-write
+// with a child stays shared after the child makes it writable.
+//
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/mman.h"
+#include "user/user.h"
+
+#define HEAPPAGES 1024
+#define ROUNDS 20
+
+static char *heap;
+static char cards[HEAPPAGES];
+static int nfaults;
+static unsigned long rand_next;
+
+static int
+rand(void)
+{
+  rand_next = rand_next * 1103515245 + 12345;
+  return (rand_next / 65536) % 32768;
+}
+
+static char**
+slot(int hot)
+{
+  int pg = rand() % hot;
+  int off = rand() % (PGSIZE / sizeof(char*));
+  return (char**)(heap + pg*PGSIZE) + off;
+}
+
+// mark a card and re-open its page, then retry the store.
+static void
+onwrite(uint64 va)
+{
+  uint64 pg = (va - (uint64)heap) / PGSIZE;
+
+  if(va < (uint64)heap || pg >= HEAPPAGES){
+    printf("gcbench: stray fault at %p\n", va);
+    exit(1);
+  }
+  cards[pg] = 1;
+  nfaults++;
+  if(mprotect(heap + pg*PGSIZE, PGSIZE, PROT_READ|PROT_WRITE) < 0){
+    printf("gcbench: mprotect failed\n");
+    exit(1);
+  }
+  sigreturn();
+}
+
+// count and clear the dirty cards.
+static int
+collect(void)
+{
+  int n = 0;
+
+  for(int i = 0; i < HEAPPAGES; i++){
+    n += cards[i];
+    cards[i] = 0;
+  }
+  return n;
+}
+
+static int
+run(char *name, int fault, int nstores, int hot)
+{
+  int t0, ticks, dirty = 0;
+  char **p;
+
+  rand_next = 1;
+  nfaults = 0;
+  if(fault){
+    sigsegv(onwrite);
+    if(mprotect(heap, HEAPPAGES*PGSIZE, PROT_READ) < 0){
+      printf("gcbench: mprotect failed\n");
+      exit(1);
+    }
+  }
+  t0 = uptime();
+  for(int r = 0; r < ROUNDS; r++){
+    for(int i = 0; i < nstores; i++){
+      p = slot(hot);
+      *p = (char*)p;
+      if(!fault)
+        cards[((char*)p - heap) / PGSIZE] = 1;
+    }
+    dirty += collect();
+    if(fault)
+      mprotect(heap, HEAPPAGES*PGSIZE, PROT_READ);
+  }
+  ticks = uptime() - t0;
+  if(fault){
+    mprotect(heap, HEAPPAGES*PGSIZE, PROT_READ|PROT_WRITE);
+    sigsegv(0);
+  }
+  printf("%s\t%d ticks\t%d dirty cards\t%d faults\n", name, ticks, dirty, nfaults);
+  return dirty;
+}
+
+// a read-only page shared with a child must stay shared when
+// the child makes it writable, and be copied on its first write.
+static void
+cowcheck(void)
+{
+  int pid, xstatus;
+
+  heap[0] = 'p';
+  mprotect(heap, PGSIZE, PROT_READ);
+  pid = fork();
+  if(pid < 0){
+    printf("gcbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    if(mprotect(heap, PGSIZE, PROT_READ|PROT_WRITE) < 0)
+      exit(1);
+    heap[0] = 'c';
+    exit(heap[0] == 'c' ? 0 : 1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || heap[0] != 'p'){
+    printf("gcbench: copy-on-write check failed\n");
+    exit(1);
+  }
+  mprotect(heap, PGSIZE, PROT_READ|PROT_WRITE);
+  printf("gcbench: copy-on-write check ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nstores = argc > 1 ? atoi(argv[1]) : 100000;
+  int hot = argc > 2 ? atoi(argv[2]) : 64;
+
+  if(nstores < 1 || hot < 1 || hot > HEAPPAGES){
+    printf("usage: gcbench [nstores [hotpages]], hotpages <= %d\n", HEAPPAGES);
+    exit(1);
+  }
+  if((heap = sbrk(HEAPPAGES*PGSIZE)) == (char*)-1){
+    printf("gcbench: sbrk failed\n");
+    exit(1);
+  }
+  memset(heap, 0, HEAPPAGES*PGSIZE);
+
+  printf("gcbench: %d rounds of %d stores into %d pages\n", ROUNDS, nstores, hot);
+  if(run("soft", 0, nstores, hot) != run("fault", 1, nstores, hot)){
+    printf("gcbench: barriers disagree\n");
+    exit(1);
+  }
+  cowcheck();
+  exit(0);
+}
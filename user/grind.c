@@ -1,5 +1,6 @@
 //
-// run random system calls in parallel forever.
+// run random system calls in parallel forever, or, with
+// "grind load ...", generate a measured load (see load()).
 //
 
 #include "kernel/param.h"
@@ -333,9 +334,275 @@ iter()
   exit(0);
 }
 
+//
+// load generator: grind load [-w workers] [-t secs] [-i secs] [op=weight ...]
+//
+// workers run a weighted random mix of operations for a fixed
+// time. every interval, each worker sends its per-operation
+// counts and latency histograms to the parent over a pipe of
+// its own, and the parent prints ops/sec and latency
+// percentiles for the interval, summed over workers.
+//
+
+enum { OP_CREATE, OP_WRITE, OP_READ, OP_FORKEXEC, OP_PIPE, OP_SBRK, NOP };
+
+char *opnames[NOP] = {
+  [OP_CREATE]   "create",    // create, close and unlink a file
+  [OP_WRITE]    "write",     // write a block at a random offset
+  [OP_READ]     "read",      // read a block at a random offset
+  [OP_FORKEXEC] "forkexec",  // fork, exec grind -x, wait
+  [OP_PIPE]     "pipe",      // 512 bytes through a pipe
+  [OP_SBRK]     "sbrk",      // grow, touch and shrink the heap
+};
+
+#define MAXWORKERS 8
+#define MAXINTERVALS 100
+#define NBUCKET 24          // latency bucket b holds [2^b, 2^(b+1)) us
+#define LOADFILE (64*BSIZE) // size of each worker's data file
+#define SBRKSIZE (16*PGSIZE)
+
+struct interval {
+  uint ops[NOP];
+  uint hist[NOP][NBUCKET];
+};
+
+int weight[NOP];
+
+int
+bucket(uint64 us)
+{
+  int b = 0;
+
+  while(b < NBUCKET-1 && us >= (2UL << b))
+    b++;
+  return b;
+}
+
+// upper bound, in us, of the latency below which frac percent
+// of h's ops completed.
+int
+percentile(uint *h, uint n, int frac)
+{
+  uint seen = 0;
+
+  for(int b = 0; b < NBUCKET; b++){
+    seen += h[b];
+    if(seen * 100 >= n * frac)
+      return 2 << b;
+  }
+  return 2 << (NBUCKET-1);
+}
+
+void
+doop(int op, int w, int fd, int *p)
+{
+  static char block[BSIZE];
+  char name[8];
+  int pid;
+  char *a;
+
+  switch(op){
+  case OP_CREATE:
+    strcpy(name, "ldc0");
+    name[3] = '0' + w;
+    close(open(name, O_CREATE|O_RDWR));
+    unlink(name);
+    break;
+  case OP_WRITE:
+    lseek(fd, (rand() % (LOADFILE/BSIZE)) * BSIZE, SEEK_SET);
+    write(fd, block, BSIZE);
+    break;
+  case OP_READ:
+    lseek(fd, (rand() % (LOADFILE/BSIZE)) * BSIZE, SEEK_SET);
+    read(fd, block, BSIZE);
+    break;
+  case OP_FORKEXEC:
+    if((pid = fork()) == 0){
+      char *argv[] = { "grind", "-x", 0 };
+      exec("/grind", argv);
+      exit(1);
+    }
+    if(pid > 0)
+      wait(0);
+    break;
+  case OP_PIPE:
+    write(p[1], block, 512);
+    read(p[0], block, 512);
+    break;
+  case OP_SBRK:
+    if((a = sbrk(SBRKSIZE)) != (char*)-1){
+      for(int i = 0; i < SBRKSIZE; i += PGSIZE)
+        a[i] = 1;
+      sbrk(-SBRKSIZE);
+    }
+    break;
+  }
+}
+
+// run the mix until end, reporting each interval on out.
+void
+loadworker(int w, int out, uint64 t0, uint64 interval, int nintervals)
+{
+  struct interval cur;
+  char name[8];
+  int fd, p[2], k = 0, total = 0, op, r;
+  uint64 now, start;
+
+  strcpy(name, "ldd0");
+  name[3] = '0' + w;
+  if((fd = open(name, O_CREATE|O_RDWR)) < 0 || pipe(p) < 0){
+    printf("grind: worker %d setup failed\n", w);
+    exit(1);
+  }
+  for(int i = 0; i < LOADFILE/BSIZE; i++)
+    doop(OP_WRITE, w, fd, p);
+  for(op = 0; op < NOP; op++)
+    total += weight[op];
+
+  memset(&cur, 0, sizeof(cur));
+  while(k < nintervals){
+    r = rand() % total;
+    for(op = 0; r >= weight[op]; op++)
+      r -= weight[op];
+    start = uptimeus();
+    doop(op, w, fd, p);
+    now = uptimeus();
+    cur.ops[op]++;
+    cur.hist[op][bucket(now - start)]++;
+    while(k < nintervals && now >= t0 + (k+1) * interval){
+      write(out, &cur, sizeof(cur));
+      memset(&cur, 0, sizeof(cur));
+      k++;
+    }
+  }
+  close(fd);
+  unlink(name);
+  exit(0);
+}
+
+// read all of a record that may be bigger than a pipe's buffer.
+int
+readall(int fd, void *dst, int n)
+{
+  int got = 0, cc;
+
+  while(got < n && (cc = read(fd, (char*)dst + got, n - got)) > 0)
+    got += cc;
+  return got;
+}
+
+int
+load(int argc, char *argv[])
+{
+  int nworkers = 4, secs = 10, isecs = 2, nintervals;
+  int fds[MAXWORKERS], p[2], i, w, op, any = 0;
+  static struct interval sum, rec;
+  uint64 t0, interval;
+  char *eq;
+
+  for(i = 0; i < argc; i++){
+    if(strcmp(argv[i], "-w") == 0 && i+1 < argc)
+      nworkers = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-t") == 0 && i+1 < argc)
+      secs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-i") == 0 && i+1 < argc)
+      isecs = atoi(argv[++i]);
+    else if((eq = strchr(argv[i], '=')) != 0){
+      for(op = 0; op < NOP; op++)
+        if(strlen(opnames[op]) == eq - argv[i] &&
+           memcmp(opnames[op], argv[i], eq - argv[i]) == 0)
+          break;
+      if(op == NOP)
+        goto usage;
+      weight[op] = atoi(eq + 1);
+      any = 1;
+    } else
+      goto usage;
+  }
+  if(!any)
+    for(op = 0; op < NOP; op++)
+      weight[op] = 1;
+  for(op = 0; op < NOP; op++)
+    if(weight[op] > 0)
+      break;
+  if(op == NOP || nworkers < 1 || nworkers > MAXWORKERS || isecs < 1 ||
+     secs < isecs || secs / isecs > MAXINTERVALS)
+    goto usage;
+
+  nintervals = secs / isecs;
+  interval = isecs * 1000000UL;
+  printf("grind: %d workers for %d s, mix", nworkers, secs);
+  for(op = 0; op < NOP; op++)
+    if(weight[op])
+      printf(" %s=%d", opnames[op], weight[op]);
+  printf("\n");
+
+  t0 = uptimeus();
+  for(w = 0; w < nworkers; w++){
+    if(pipe(p) < 0){
+      printf("grind: pipe failed\n");
+      exit(1);
+    }
+    int pid = fork();
+    if(pid < 0){
+      printf("grind: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(p[0]);
+      for(i = 0; i < w; i++)
+        close(fds[i]);
+      rand_next = w + 1;
+      loadworker(w, p[1], t0, interval, nintervals);
+    }
+    close(p[1]);
+    fds[w] = p[0];
+  }
+
+  for(int k = 0; k < nintervals; k++){
+    memset(&sum, 0, sizeof(sum));
+    for(w = 0; w < nworkers; w++){
+      if(readall(fds[w], &rec, sizeof(rec)) != sizeof(rec)){
+        printf("grind: worker %d died\n", w);
+        exit(1);
+      }
+      for(op = 0; op < NOP; op++){
+        sum.ops[op] += rec.ops[op];
+        for(i = 0; i < NBUCKET; i++)
+          sum.hist[op][i] += rec.hist[op][i];
+      }
+    }
+    printf("%d s:\top\tops/s\tp50us\tp90us\tp99us\n", (k+1) * isecs);
+    for(op = 0; op < NOP; op++){
+      if(sum.ops[op] == 0)
+        continue;
+      printf("\t%s\t%d\t%d\t%d\t%d\n", opnames[op], sum.ops[op] / isecs,
+             percentile(sum.hist[op], sum.ops[op], 50),
+             percentile(sum.hist[op], sum.ops[op], 90),
+             percentile(sum.hist[op], sum.ops[op], 99));
+    }
+  }
+  for(w = 0; w < nworkers; w++)
+    wait(0);
+  return 0;
+
+usage:
+  printf("usage: grind load [-w workers] [-t secs] [-i secs] [op=weight ...]\n");
+  printf("ops:");
+  for(op = 0; op < NOP; op++)
+    printf(" %s", opnames[op]);
+  printf("\n");
+  return 1;
+}
+
 int
-main()
+main(int argc, char *argv[])
 {
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit(0);  // the load generator's exec target
+  if(argc > 1 && strcmp(argv[1], "load") == 0)
+    exit(load(argc - 2, argv + 2));
+
   while(1){
     int pid = fork();
     if(pid == 0){
@@ -1,6 +1,7 @@
 // init: The initial user-level program
 
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/stat.h"
 #include "kernel/spinlock.h"
 #include "kernel/sleeplock.h"
@@ -23,6 +24,11 @@ main(void)
   dup(0);  // stdout
   dup(0);  // stderr
 
+  // scratch space on the RAM disk.
+  mkdir("tmp");
+  if(mount("tmp", RAMDEV) < 0)
+    printf("init: cannot mount /tmp\n");
+
   for(;;){
     printf("init: starting sh\n");
     pid = fork();
@@ -0,0 +1,220 @@
+//
+// disk benchmarks.
+//
+// iobench rand [nreads], or iobench nreads: random 1 KiB reads
+// from a file that is much larger than the buffer cache, so most
+// reads reach the disk.
+// run under "make qemu PACKED=on" and "make qemu PACKED=off" to
+// compare packed and split virtqueues.
+//
+// iobench seq [njobs]: njobs processes each write and then read
+// back their own file sequentially; reports aggregate throughput.
+// run under "make qemu NDISK=1", 2 and 4 to compare striping.
+//
+// iobench pread [njobs]: njobs processes read the same small,
+// cached file over and over, so they contend for the same buffer
+// and inode sleep-locks; reports context switches per bread().
+//
+// files are created in the current directory, so running
+// "cd /tmp; /iobench seq 4" measures the RAM disk instead.
+//
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/kstat.h"
+
+#define NBLOCKS MAXFILE
+#define SEQBLOCKS 128   // per job, so four jobs fit on the disk
+#define PRBLOCKS 8      // small enough to stay in the buffer cache
+#define PRPASSES 200    // reads of the whole file, per job
+
+static char buf[BSIZE];
+static unsigned long rand_next = 1;
+
+static int
+rand(void)
+{
+  rand_next = rand_next * 1103515245 + 12345;
+  return (rand_next / 65536) % 32768;
+}
+
+// create path holding nblocks blocks; block i starts with byte i.
+static int
+mkdata(char *path, int nblocks)
+{
+  int fd, i;
+
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    printf("iobench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(i = 0; i < nblocks; i++){
+    buf[0] = i;
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("iobench: write failed\n");
+      exit(1);
+    }
+  }
+  return fd;
+}
+
+void
+randread(int n)
+{
+  char *path = "iobench.dat";
+  int fd, i, start, ticks;
+
+  fd = mkdata(path, NBLOCKS);
+
+  start = uptime();
+  for(i = 0; i < n; i++){
+    int bn = rand() % NBLOCKS;
+    if(lseek(fd, bn * BSIZE, SEEK_SET) != bn * BSIZE ||
+       read(fd, buf, BSIZE) != BSIZE){
+      printf("iobench: read of block %d failed\n", bn);
+      exit(1);
+    }
+    if((uchar)buf[0] != (uchar)bn){
+      printf("iobench: block %d has wrong contents\n", bn);
+      exit(1);
+    }
+  }
+  ticks = uptime() - start;
+
+  printf("iobench: %d random %d-byte reads in %d ticks\n", n, BSIZE, ticks);
+  if(ticks > 0)
+    printf("iobench: %d reads per tick\n", n / ticks);
+
+  close(fd);
+  unlink(path);
+}
+
+void
+seqrw(int njobs)
+{
+  char path[] = "iobench0";
+  int i, j, fd, pid, start, ticks, xstatus, kb;
+
+  start = uptime();
+  for(i = 0; i < njobs; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("iobench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      path[7] = '0' + i;
+      fd = mkdata(path, SEQBLOCKS);
+      close(fd);
+      fd = open(path, O_RDONLY);
+      for(j = 0; j < SEQBLOCKS; j++){
+        if(read(fd, buf, BSIZE) != BSIZE || (uchar)buf[0] != (uchar)j){
+          printf("iobench: bad read of block %d\n", j);
+          exit(1);
+        }
+      }
+      close(fd);
+      unlink(path);
+      exit(0);
+    }
+  }
+  for(i = 0; i < njobs; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  ticks = uptime() - start;
+
+  // each job writes and reads SEQBLOCKS blocks.
+  kb = njobs * SEQBLOCKS * 2 * (BSIZE / 1024);
+  printf("iobench: %d jobs moved %d KiB sequentially in %d ticks\n",
+         njobs, kb, ticks);
+  if(ticks > 0)
+    printf("iobench: %d KiB per tick\n", kb / ticks);
+}
+
+void
+sharedread(int njobs)
+{
+  char *path = "iobench.shr";
+  int i, j, fd, pid, start, ticks, xstatus;
+  struct kstat k0, k1;
+  uint64 nbread, nswtch;
+
+  fd = mkdata(path, PRBLOCKS);
+  close(fd);
+
+  kstat(&k0);
+  start = uptime();
+  for(i = 0; i < njobs; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("iobench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      fd = open(path, O_RDONLY);
+      for(j = 0; j < PRPASSES * PRBLOCKS; j++){
+        if(j % PRBLOCKS == 0)
+          lseek(fd, 0, SEEK_SET);
+        if(read(fd, buf, BSIZE) != BSIZE){
+          printf("iobench: read failed\n");
+          exit(1);
+        }
+      }
+      close(fd);
+      exit(0);
+    }
+  }
+  for(i = 0; i < njobs; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  ticks = uptime() - start;
+  kstat(&k1);
+  unlink(path);
+
+  nbread = k1.nbread - k0.nbread;
+  nswtch = k1.nswtch - k0.nswtch;
+  printf("iobench: %d jobs, %d reads in %d ticks\n",
+         njobs, njobs * PRPASSES * PRBLOCKS, ticks);
+  printf("iobench: %d breads, %d context switches, %d per 1000 breads\n",
+         (int)nbread, (int)nswtch, nbread ? (int)(nswtch * 1000 / nbread) : 0);
+  printf("iobench: sleep-lock waits: %d spun, %d slept\n",
+         (int)(k1.nsleepspin - k0.nsleepspin),
+         (int)(k1.nsleepblock - k0.nsleepblock));
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1 && strcmp(argv[1], "seq") == 0){
+    int njobs = argc > 2 ? atoi(argv[2]) : 1;
+    if(njobs < 1 || njobs > 10){
+      printf("iobench: njobs must be between 1 and 10\n");
+      exit(1);
+    }
+    seqrw(njobs);
+  } else if(argc > 1 && strcmp(argv[1], "pread") == 0){
+    int njobs = argc > 2 ? atoi(argv[2]) : 4;
+    if(njobs < 1 || njobs > 10){
+      printf("iobench: njobs must be between 1 and 10\n");
+      exit(1);
+    }
+    sharedread(njobs);
+  } else if(argc == 1 || strcmp(argv[1], "rand") == 0){
+    randread(argc > 2 ? atoi(argv[2]) : 1000);
+  } else if(argc == 2 && argv[1][0] >= '0' && argv[1][0] <= '9'){
+    randread(atoi(argv[1]));  // the old "iobench nreads"
+  } else {
+    printf("usage: iobench [rand [nreads] | nreads | seq [njobs] | pread [njobs]]\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,49 @@
+//
+// show per-hart device interrupt counts, or change
+// which harts a device IRQ is delivered to.
+//
+// usage: irq                print counts and affinity of each IRQ
+//        irq IRQ MASK       route IRQ to the harts in MASK, or
+//                           to the submitting hart if MASK is 0
+//
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  uint64 counts[NCPU];
+  int irq, aff, h;
+
+  if(argc == 3){
+    if(irqaffinity(atoi(argv[1]), atoi(argv[2])) < 0){
+      fprintf(2, "irq: cannot route irq %s to %s\n", argv[1], argv[2]);
+      exit(1);
+    }
+    exit(0);
+  }
+  if(argc != 1){
+    fprintf(2, "usage: irq [IRQ MASK]\n");
+    exit(1);
+  }
+
+  printf("irq affinity");
+  for(h = 0; h < NCPU; h++)
+    printf(" hart%d", h);
+  printf("\n");
+  for(irq = 1; irq < NIRQ; irq++){
+    if((aff = irqstat(irq, counts)) < 0)
+      continue;
+    if(aff == IRQ_SUBMITTER)
+      printf("%d submitter", irq);
+    else
+      printf("%d %x", irq, aff);
+    for(h = 0; h < NCPU; h++)
+      printf(" %l", counts[h]);
+    printf("\n");
+  }
+  exit(0);
+}
@@ -0,0 +1,94 @@
+//
+// kernel synchronization scaling benchmark.
+//
+// lockbench [nticks [maxprocs]]: for each test, and for 1 to
+// maxprocs processes, every process runs the test for nticks
+// ticks. the tests are:
+//   tas, ticket, mcs: acquire the same kernel spinlock of
+//     that kind over and over.
+//   pidscan, pidrcu: look up a pid by locking each proc in
+//     turn, as kill() used to, or lock-free in the RCU pid table.
+// prints one line per run: total operations per tick
+// (throughput), and the fewest and most by any one process
+// (fairness). run with "make qemu CPUS=8" so each process
+// has its own hart.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+struct test {
+  char *name;
+  int (*fn)(int, int);
+  int arg;
+} tests[] = {
+  { "tas", lockbench, 0 },
+  { "ticket", lockbench, 1 },
+  { "mcs", lockbench, 2 },
+  { "pidscan", rcubench, 0 },
+  { "pidrcu", rcubench, 1 },
+};
+
+void
+run(struct test *t, int nprocs, int nticks)
+{
+  int fds[2], i, n, total, min, max, xstatus;
+
+  if(pipe(fds) < 0){
+    printf("lockbench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nprocs; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[0]);
+      n = t->fn(t->arg, nticks);
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+
+  total = 0;
+  min = -1;
+  max = 0;
+  for(i = 0; i < nprocs; i++){
+    if(read(fds[0], &n, sizeof(n)) != sizeof(n) || n < 0){
+      printf("lockbench: child failed\n");
+      exit(1);
+    }
+    total += n;
+    if(min < 0 || n < min)
+      min = n;
+    if(n > max)
+      max = n;
+  }
+  close(fds[0]);
+  for(i = 0; i < nprocs; i++)
+    wait(&xstatus);
+
+  printf("%s\t%d\t%d\t%d\t%d\n", t->name, nprocs, total / nticks, min, max);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nticks = argc > 1 ? atoi(argv[1]) : 10;
+  int maxprocs = argc > 2 ? atoi(argv[2]) : NCPU;
+
+  if(nticks < 1 || maxprocs < 1 || maxprocs > NPROC/2){
+    printf("usage: lockbench [nticks [maxprocs]]\n");
+    exit(1);
+  }
+
+  printf("test\tprocs\tops/tick\tmin\tmax\n");
+  for(int i = 0; i < sizeof(tests)/sizeof(tests[0]); i++)
+    for(int nprocs = 1; nprocs <= maxprocs; nprocs++)
+      run(&tests[i], nprocs, nticks);
+  exit(0);
+}
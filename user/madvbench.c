@@ -0,0 +1,106 @@
+//
+// madvise() benchmarks on a 32 MiB lazily allocated heap region.
+//
+// for each hint, grows the heap, gives the hint, writes one
+// byte per page, and reports the time taken and the number of
+// lazy-allocation page faults taken:
+//   lazy:       no hint, one fault per page.
+//   willneed:   MADV_WILLNEED maps the region in one call.
+//   sequential: MADV_SEQUENTIAL maps FAULTAROUND pages per fault.
+//   dontneed:   MADV_DONTNEED on the touched region; reports
+//               the pages freed and checks they read back as zero.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/kstat.h"
+#include "kernel/mman.h"
+#include "user/user.h"
+
+#define REGION (32*1024*1024)
+
+static void
+touch(char *p)
+{
+  for(int i = 0; i < REGION; i += PGSIZE)
+    p[i] = 1;
+}
+
+static char*
+grow(void)
+{
+  char *p = sbrk(REGION);
+  if(p == (char*)-1){
+    printf("madvbench: sbrk failed\n");
+    exit(1);
+  }
+  return p;
+}
+
+static void
+report(char *name, int ticks, struct kstat *k0, struct kstat *k1)
+{
+  printf("%s\t%d ticks\t%d faults\n", name, ticks,
+         (int)(k1->nlazyfault - k0->nlazyfault));
+}
+
+static void
+hinted(char *name, int advice)
+{
+  struct kstat k0, k1;
+  char *p;
+  int t0;
+
+  p = grow();
+  kstat(&k0);
+  t0 = uptime();
+  if(advice != MADV_NORMAL && madvise(p, REGION, advice) < 0){
+    printf("madvbench: madvise failed\n");
+    exit(1);
+  }
+  touch(p);
+  kstat(&k1);
+  report(name, uptime() - t0, &k0, &k1);
+  sbrk(-REGION);
+}
+
+static void
+dontneed(void)
+{
+  struct meminfo m0, m1;
+  struct kstat k0, k1;
+  char *p;
+  int t0;
+
+  p = grow();
+  touch(p);
+  meminfo(&m0);
+  kstat(&k0);
+  t0 = uptime();
+  if(madvise(p, REGION, MADV_DONTNEED) < 0){
+    printf("madvbench: madvise failed\n");
+    exit(1);
+  }
+  kstat(&k1);
+  meminfo(&m1);
+  report("dontneed", uptime() - t0, &k0, &k1);
+  printf("dontneed\t%d pages freed\n", (int)(m1.free - m0.free));
+  for(int i = 0; i < REGION; i += PGSIZE){
+    if(p[i] != 0){
+      printf("madvbench: page at %d not zero after MADV_DONTNEED\n", i);
+      exit(1);
+    }
+  }
+  sbrk(-REGION);
+}
+
+int
+main(void)
+{
+  hinted("lazy", MADV_NORMAL);
+  hinted("willneed", MADV_WILLNEED);
+  hinted("sequential", MADV_SEQUENTIAL);
+  dontneed();
+  exit(0);
+}
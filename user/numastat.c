@@ -0,0 +1,27 @@
+//
+// numastat: how many page allocations were served from the
+// allocating hart's own NUMA node, and how many from another.
+// run under "make qemu NUMA=2 CPUS=4".
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+int
+main(void)
+{
+  struct kstat ks;
+  uint64 total;
+
+  if(kstat(&ks) < 0){
+    printf("numastat: kstat failed\n");
+    exit(1);
+  }
+  total = ks.nalloclocal + ks.nallocremote;
+  printf("local\t%d\nremote\t%d\n", (int)ks.nalloclocal, (int)ks.nallocremote);
+  if(total > 0)
+    printf("local%%\t%d\n", (int)(ks.nalloclocal * 100 / total));
+  exit(0);
+}
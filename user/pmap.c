@@ -0,0 +1,69 @@
+//
+// pmap [pid ...]: the physical memory used by processes, per
+// region, in pages. with no arguments, reports every process
+// older than pmap itself (pids increase, so that is every
+// process but pmap's own later children).
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+static char *regions[NPMREGION] = {
+  [PM_TEXT]  "text/data",
+  [PM_STACK] "stack",
+  [PM_HEAP]  "heap",
+};
+
+static int
+pmap(int pid)
+{
+  struct procmem pm;
+  struct pmregion *r;
+  uint64 resident = 0, shared = 0;
+  int i;
+
+  if(procmem(pid, &pm) < 0)
+    return -1;
+  for(i = 0; i < NPMREGION; i++){
+    resident += pm.region[i].resident;
+    shared += pm.region[i].shared;
+  }
+
+  printf("%d %s: %d KiB address space, %d resident, %d shared, %d private, "
+         "%d page-table pages, stack peak %d KiB\n",
+         pm.pid, pm.name, (int)(pm.sz / 1024), (int)resident, (int)shared,
+         (int)(resident - shared), (int)pm.ptpages, (int)(pm.stackpeak / 1024));
+  printf("  region\tstart\tend\tresident\tshared\tcow\thuge\n");
+  for(i = 0; i < NPMREGION; i++){
+    r = &pm.region[i];
+    if(r->start == r->end)
+      continue;
+    printf("  %s\t%x\t%x\t%d\t%d\t%d\t%d\n", regions[i], (int)r->start,
+           (int)r->end, (int)r->resident, (int)r->shared, (int)r->cow,
+           (int)r->huge);
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, status = 0;
+
+  if(argc > 1){
+    for(i = 1; i < argc; i++){
+      if(pmap(atoi(argv[i])) < 0){
+        printf("pmap: no process %s\n", argv[i]);
+        status = 1;
+      }
+    }
+    exit(status);
+  }
+
+  for(i = 1; i <= getpid(); i++)
+    pmap(i);
+  exit(0);
+}
@@ -0,0 +1,229 @@
+//
+// replay [-t] file: re-issue the file system calls of a trace
+// recorded by "trace -o file cmd", as fast as possible or, with
+// -t, at their recorded times; then report the time taken and
+// each call's count and mean latency.
+//
+// the calls of all the traced processes are replayed in
+// order by this one process. file descriptors are mapped per
+// recorded pid; a fork gives the child dup()s of its parent's.
+// calls on descriptors the trace did not open (the console),
+// and calls other than file system ones, are skipped.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NREC 32
+#define NMAP 64
+#define NSYS 64
+
+static struct tracerec rec[NREC];
+static char buf[8192];
+
+static struct fdmap {
+  int pid;   // 0 if unused
+  int rfd;   // fd in the trace
+  int fd;    // fd here
+} map[NMAP];
+
+static struct {
+  int n;
+  uint64 us;
+} stats[NSYS];
+
+// the calls that are replayed.
+static char *names[NSYS] = {
+[SYS_read]   "read",
+[SYS_fstat]  "fstat",
+[SYS_chdir]  "chdir",
+[SYS_dup]    "dup",
+[SYS_open]   "open",
+[SYS_write]  "write",
+[SYS_unlink] "unlink",
+[SYS_mkdir]  "mkdir",
+[SYS_close]  "close",
+[SYS_lseek]  "lseek",
+[SYS_fsync]  "fsync",
+};
+
+static int nmismatch, nskip;
+
+static struct fdmap*
+lookup(int pid, int rfd)
+{
+  for(int i = 0; i < NMAP; i++)
+    if(map[i].pid == pid && map[i].rfd == rfd)
+      return &map[i];
+  return 0;
+}
+
+static void
+addmap(int pid, int rfd, int fd)
+{
+  for(int i = 0; i < NMAP; i++){
+    if(map[i].pid == 0){
+      map[i].pid = pid;
+      map[i].rfd = rfd;
+      map[i].fd = fd;
+      return;
+    }
+  }
+  close(fd);
+}
+
+// read or write n bytes, a buffer at a time. returns the
+// number of bytes moved, or -1.
+static int
+rdwr(int wr, int fd, uint64 n)
+{
+  int cc, total = 0;
+
+  while(n > 0){
+    cc = n < sizeof(buf) ? n : sizeof(buf);
+    cc = wr ? write(fd, buf, cc) : read(fd, buf, cc);
+    if(cc < 0)
+      return total ? total : -1;
+    if(cc == 0)
+      break;
+    total += cc;
+    n -= cc;
+  }
+  return total;
+}
+
+// re-issue r. returns its result, or -2 if it was skipped.
+static int
+issue(struct tracerec *r)
+{
+  struct fdmap *m = 0;
+  struct stat st;
+  int ret = -2, i, fd;
+
+  if(r->num == SYS_read || r->num == SYS_write || r->num == SYS_close ||
+     r->num == SYS_lseek || r->num == SYS_fstat || r->num == SYS_dup ||
+     r->num == SYS_fsync){
+    if((m = lookup(r->pid, r->arg[0])) == 0)
+      return -2;
+  }
+
+  switch(r->num){
+  case SYS_open:
+    ret = open(r->path, r->arg[1]);
+    if(ret >= 0 && (int)r->ret >= 0)
+      addmap(r->pid, r->ret, ret);
+    else if(ret >= 0)
+      close(ret);
+    break;
+  case SYS_close:
+    ret = close(m->fd);
+    m->pid = 0;
+    break;
+  case SYS_read:
+  case SYS_write:
+    ret = rdwr(r->num == SYS_write, m->fd, r->arg[2]);
+    break;
+  case SYS_lseek:
+    ret = lseek(m->fd, r->arg[1], r->arg[2]);
+    break;
+  case SYS_fstat:
+    ret = fstat(m->fd, &st);
+    break;
+  case SYS_fsync:
+    ret = fsync(m->fd);
+    break;
+  case SYS_dup:
+    if((ret = dup(m->fd)) >= 0)
+      addmap(r->pid, r->ret, ret);
+    break;
+  case SYS_unlink:
+    ret = unlink(r->path);
+    break;
+  case SYS_mkdir:
+    ret = mkdir(r->path);
+    break;
+  case SYS_chdir:
+    ret = chdir(r->path);
+    break;
+  case SYS_fork:
+    if((int)r->ret <= 0)
+      return -2;
+    for(i = 0; i < NMAP; i++)
+      if(map[i].pid == r->pid && (fd = dup(map[i].fd)) >= 0)
+        addmap(r->ret, map[i].rfd, fd);
+    return -2;
+  case SYS_exit:
+    for(i = 0; i < NMAP; i++){
+      if(map[i].pid == r->pid){
+        close(map[i].fd);
+        map[i].pid = 0;
+      }
+    }
+    return -2;
+  }
+  return ret;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int timed = 0, fd, n, i, ret, total = 0;
+  uint64 t0 = 0, start, now, before;
+  struct tracerec *r;
+
+  if(argc == 3 && strcmp(argv[1], "-t") == 0)
+    timed = 1;
+  else if(argc != 2){
+    printf("usage: replay [-t] file\n");
+    exit(1);
+  }
+  if((fd = open(argv[argc-1], O_RDONLY)) < 0){
+    printf("replay: cannot open %s\n", argv[argc-1]);
+    exit(1);
+  }
+
+  start = uptimeus();
+  while((n = read(fd, rec, sizeof(rec))) > 0){
+    for(i = 0; i < n / sizeof(rec[0]); i++){
+      r = &rec[i];
+      if(t0 == 0)
+        t0 = r->time;
+      if(timed){
+        while((now = uptimeus()) - start < r->time - t0){
+          if(r->time - t0 - (now - start) > 200000)
+            sleep(1);
+        }
+      }
+      before = uptimeus();
+      ret = issue(r);
+      if(ret == -2){
+        nskip++;
+        continue;
+      }
+      if(r->num < NSYS){
+        stats[r->num].n++;
+        stats[r->num].us += uptimeus() - before;
+      }
+      if((ret < 0) != ((int)r->ret < 0))
+        nmismatch++;
+      total++;
+    }
+  }
+  close(fd);
+  for(i = 0; i < NMAP; i++)
+    if(map[i].pid)
+      close(map[i].fd);
+
+  printf("replay: %d calls in %d ms, %d skipped, %d with a different outcome\n",
+         total, (int)((uptimeus() - start) / 1000), nskip, nmismatch);
+  printf("call\tcount\tmean us\n");
+  for(i = 0; i < NSYS; i++)
+    if(stats[i].n)
+      printf("%s\t%d\t%d\n", names[i], stats[i].n, (int)(stats[i].us / stats[i].n));
+  exit(0);
+}
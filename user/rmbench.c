@@ -0,0 +1,76 @@
+//
+// rmbench [-n reps]: the latency of unlink() and of open() with
+// O_TRUNC, against the size of the file they discard. files
+// with an indirect block leave freeing their blocks to truncd.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static char buf[BSIZE];
+static int sizes[] = { 1, 4, NDIRECT, NDIRECT + 1, 64, 128, MAXFILE };
+
+static void
+mkfile(char *name, int nblocks)
+{
+  int fd, i;
+
+  if((fd = open(name, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    printf("rmbench: cannot create %s\n", name);
+    exit(1);
+  }
+  for(i = 0; i < nblocks; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("rmbench: write %s failed\n", name);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int reps = 3, i, r, fd;
+  uint64 t0, unlinkus, truncus;
+
+  if(argc == 3 && strcmp(argv[1], "-n") == 0)
+    reps = atoi(argv[2]);
+  else if(argc != 1){
+    printf("usage: rmbench [-n reps]\n");
+    exit(1);
+  }
+  if(reps < 1){
+    printf("rmbench: reps must be positive\n");
+    exit(1);
+  }
+
+  printf("blocks\tunlink us\tO_TRUNC us\n");
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    unlinkus = truncus = 0;
+    for(r = 0; r < reps; r++){
+      mkfile("rmb.tmp", sizes[i]);
+      t0 = uptimeus();
+      if(unlink("rmb.tmp") < 0){
+        printf("rmbench: unlink failed\n");
+        exit(1);
+      }
+      unlinkus += uptimeus() - t0;
+
+      mkfile("rmb.tmp", sizes[i]);
+      t0 = uptimeus();
+      if((fd = open("rmb.tmp", O_TRUNC|O_WRONLY)) < 0){
+        printf("rmbench: open O_TRUNC failed\n");
+        exit(1);
+      }
+      truncus += uptimeus() - t0;
+      close(fd);
+      unlink("rmb.tmp");
+    }
+    printf("%d\t%d\t\t%d\n", sizes[i], (int)(unlinkus / reps), (int)(truncus / reps));
+  }
+  exit(0);
+}
@@ -0,0 +1,103 @@
+//
+// smallbench [-n files]: create, write, read back and unlink
+// files small enough to live in their inodes, then files just
+// too big to, and report the time and the disk blocks read and
+// written per file for each phase. files go in the current
+// directory.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+enum { CREATE, READ, UNLINK, NPHASE };
+
+static char *phases[NPHASE] = { "create+write", "read", "unlink" };
+static char buf[BSIZE];
+
+static void
+name(char *s, int i)
+{
+  strcpy(s, "sb.000");
+  s[3] = '0' + (i / 100) % 10;
+  s[4] = '0' + (i / 10) % 10;
+  s[5] = '0' + i % 10;
+}
+
+static void
+phase(int ph, int nfiles, int size)
+{
+  char s[8];
+  int i, fd;
+
+  for(i = 0; i < nfiles; i++){
+    name(s, i);
+    if(ph == CREATE){
+      fd = open(s, O_CREATE|O_TRUNC|O_WRONLY);
+      if(fd < 0 || write(fd, buf, size) != size){
+        printf("smallbench: write %s failed\n", s);
+        exit(1);
+      }
+      close(fd);
+    } else if(ph == READ){
+      fd = open(s, O_RDONLY);
+      if(fd < 0 || read(fd, buf, BSIZE) != size){
+        printf("smallbench: read %s failed\n", s);
+        exit(1);
+      }
+      close(fd);
+    } else if(unlink(s) < 0){
+      printf("smallbench: unlink %s failed\n", s);
+      exit(1);
+    }
+  }
+}
+
+static void
+run(int nfiles, int size)
+{
+  struct kstat k0, k1;
+  uint64 t0;
+  int ph;
+
+  printf("%d-byte files (%s):\n", size, size <= INLINESIZE ? "inline" : "one block");
+  printf("  phase\t\tus/file\treads/file\twrites/file\n");
+  for(ph = 0; ph < NPHASE; ph++){
+    kstat(&k0);
+    t0 = uptimeus();
+    phase(ph, nfiles, size);
+    t0 = uptimeus() - t0;
+    kstat(&k1);
+    // tenths, for the averages below one.
+    printf("  %s\t%d\t%d.%d\t\t%d.%d\n", phases[ph], (int)(t0 / nfiles),
+           (int)((k1.ndiskread - k0.ndiskread) / nfiles),
+           (int)((k1.ndiskread - k0.ndiskread) * 10 / nfiles % 10),
+           (int)((k1.ndiskwrite - k0.ndiskwrite) / nfiles),
+           (int)((k1.ndiskwrite - k0.ndiskwrite) * 10 / nfiles % 10));
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nfiles = 50;
+
+  if(argc == 3 && strcmp(argv[1], "-n") == 0)
+    nfiles = atoi(argv[2]);
+  else if(argc != 1){
+    printf("usage: smallbench [-n files]\n");
+    exit(1);
+  }
+  if(nfiles < 1 || nfiles > 999){
+    printf("smallbench: files must be between 1 and 999\n");
+    exit(1);
+  }
+  memset(buf, 'c', sizeof(buf));
+  run(nfiles, 40);
+  run(nfiles, INLINESIZE + 8);
+  exit(0);
+}
@@ -0,0 +1,107 @@
+//
+// sparse [-n writes]: lay out a 256 KiB file twice, first by
+// writing all of it, then by seeking past the end and writing
+// one block at each of writes evenly spaced offsets, leaving
+// holes between them. reports each file's size, the disk
+// blocks it holds and the time the writes took; then lists the
+// sparse file's data with SEEK_DATA and SEEK_HOLE and checks
+// that its holes read as zeroes.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FILESIZE (256*1024)
+
+static char buf[BSIZE];
+
+static void
+report(char *what, char *name, uint64 us)
+{
+  struct stat st;
+
+  if(stat(name, &st) < 0){
+    printf("sparse: cannot stat %s\n", name);
+    exit(1);
+  }
+  printf("%s: %d bytes, %d blocks (%d KiB) on disk, written in %d us\n",
+         what, (int)st.size, st.blocks, st.blocks * BSIZE / 1024, (int)us);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, n = 8, off, hole, stride;
+  uint64 t0;
+
+  if(argc == 3 && strcmp(argv[1], "-n") == 0)
+    n = atoi(argv[2]);
+  else if(argc != 1){
+    printf("usage: sparse [-n writes]\n");
+    exit(1);
+  }
+  if(n < 1 || n > FILESIZE / BSIZE){
+    printf("sparse: writes must be between 1 and %d\n", FILESIZE / BSIZE);
+    exit(1);
+  }
+  stride = FILESIZE / n / BSIZE * BSIZE;
+  memset(buf, 'x', BSIZE);
+
+  // dense: every block written.
+  t0 = uptimeus();
+  if((fd = open("dense.tmp", O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    printf("sparse: cannot create dense\n");
+    exit(1);
+  }
+  for(i = 0; i < FILESIZE / BSIZE; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      printf("sparse: write dense failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  report("dense", "dense.tmp", uptimeus() - t0);
+
+  // sparse: the last block of each stride, the last one ending
+  // the file.
+  t0 = uptimeus();
+  if((fd = open("sparse.tmp", O_CREATE|O_TRUNC|O_RDWR)) < 0){
+    printf("sparse: cannot create sparse\n");
+    exit(1);
+  }
+  for(i = 1; i <= n; i++){
+    off = i == n ? FILESIZE - BSIZE : i * stride - BSIZE;
+    if(lseek(fd, off, SEEK_SET) != off || write(fd, buf, BSIZE) != BSIZE){
+      printf("sparse: write sparse at %d failed\n", off);
+      exit(1);
+    }
+  }
+  report("sparse", "sparse.tmp", uptimeus() - t0);
+
+  printf("data in sparse:");
+  for(off = 0; (off = lseek(fd, off, SEEK_DATA)) >= 0; off = hole){
+    hole = lseek(fd, off, SEEK_HOLE);
+    printf(" %d-%d", off, hole - 1);
+  }
+  printf("\n");
+
+  lseek(fd, 0, SEEK_SET);
+  for(off = 0; off < FILESIZE - BSIZE; off += BSIZE){
+    if(read(fd, buf, BSIZE) != BSIZE){
+      printf("sparse: read sparse failed\n");
+      exit(1);
+    }
+    if((off + BSIZE) % stride != 0 && buf[0] != 0){
+      printf("sparse: hole at %d does not read as zeroes\n", off);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  unlink("dense.tmp");
+  unlink("sparse.tmp");
+  exit(0);
+}
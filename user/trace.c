@@ -0,0 +1,147 @@
+//
+// system call traces.
+//
+// trace -o file cmd [arg ...]: run cmd with its system calls,
+// and those of its descendants, recorded into file.
+// trace file: print a recorded trace.
+//
+// replay re-issues a recorded trace.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+#define NREC 32
+
+static struct tracerec rec[NREC];
+
+static char *names[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_lseek]   "lseek",
+[SYS_mount]   "mount",
+[SYS_fsync]   "fsync",
+[SYS_clone]   "clone",
+};
+
+static void
+record(char *path, char **argv)
+{
+  struct kstat k0, k1;
+  int fd, p[2], pid, n, total = 0;
+  char c;
+
+  if((fd = open(path, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    printf("trace: cannot create %s\n", path);
+    exit(1);
+  }
+  if(pipe(p) < 0){
+    printf("trace: pipe failed\n");
+    exit(1);
+  }
+  kstat(&k0);
+  if((pid = fork()) < 0){
+    printf("trace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    // wait until the parent has turned on tracing, so that
+    // the trace starts with the exec.
+    close(p[1]);
+    close(fd);
+    read(p[0], &c, 1);
+    exec(argv[0], argv);
+    printf("trace: exec %s failed\n", argv[0]);
+    exit(1);
+  }
+  close(p[0]);
+  if(trace(pid, 1) < 0){
+    printf("trace: cannot trace pid %d\n", pid);
+    exit(1);
+  }
+  write(p[1], "x", 1);
+  close(p[1]);
+
+  while((n = tracedump(rec, NREC)) > 0){
+    if(write(fd, rec, n * sizeof(rec[0])) != n * sizeof(rec[0])){
+      printf("trace: write %s failed\n", path);
+      exit(1);
+    }
+    total += n;
+  }
+  wait(0);
+  kstat(&k1);
+  close(fd);
+  fprintf(2, "trace: %d calls recorded, %d dropped\n", total,
+          (int)(k1.ntracedrop - k0.ntracedrop));
+}
+
+static void
+print(char *path)
+{
+  int fd, n, i;
+  uint64 t0 = 0;
+  struct tracerec *r;
+
+  if((fd = open(path, O_RDONLY)) < 0){
+    printf("trace: cannot open %s\n", path);
+    exit(1);
+  }
+  while((n = read(fd, rec, sizeof(rec))) > 0){
+    for(i = 0; i < n / sizeof(rec[0]); i++){
+      r = &rec[i];
+      if(t0 == 0)
+        t0 = r->time;
+      printf("%d\t%d\t", (int)(r->time - t0), r->pid);
+      if(r->num > 0 && r->num < sizeof(names)/sizeof(names[0]) && names[r->num])
+        printf("%s", names[r->num]);
+      else
+        printf("syscall%d", r->num);
+      if(r->path[0])
+        printf("(\"%s\", %d, %d)", r->path, (int)r->arg[1], (int)r->arg[2]);
+      else
+        printf("(%d, %d, %d)", (int)r->arg[0], (int)r->arg[1], (int)r->arg[2]);
+      printf(" = %d\n", (int)r->ret);
+    }
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc >= 4 && strcmp(argv[1], "-o") == 0)
+    record(argv[2], argv + 3);
+  else if(argc == 2)
+    print(argv[1]);
+  else {
+    printf("usage: trace -o file cmd [arg ...] | trace file\n");
+    exit(1);
+  }
+  exit(0);
+}
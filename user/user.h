@@ -1,4 +1,8 @@
 struct stat;
+struct kstat;
+struct meminfo;
+struct procmem;
+struct tracerec;
 
 // system calls
 int fork(void);
@@ -22,6 +26,25 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int lseek(int, int, int);
+int mount(const char*, int);
+int irqaffinity(int, int);
+int irqstat(int, uint64*);
+int lockbench(int, int);
+int kstat(struct kstat*);
+int rcubench(int, int);
+int meminfo(struct meminfo*);
+int madvise(void*, uint64, int);
+int mprotect(void*, uint64, int);
+int sigsegv(void (*)(uint64));
+int sigreturn(void);
+int procmem(int, struct procmem*);
+uint64 uptimeus(void);
+int trace(int, int);
+int tracedump(struct tracerec*, int);
+int fsync(int);
+int datamode(int);
+int clone(const char*, const char*);
 
 // ulib.c
 int stat(const char*, struct stat*);
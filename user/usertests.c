@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/mman.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -16,6 +17,10 @@
 // kernel printing usertrap messages, which can be ignored if test
 // prints "OK".
 //
+// usertests -p runs the tests in parallel, -jN at a time (4 by
+// default), -nN times over, and prints a table of each test's
+// elapsed ticks.
+//
 
 #define BUFSZ  ((MAXOPBLOCKS+2)*BSIZE)
 
@@ -629,6 +634,312 @@ writebig(char *s)
   }
 }
 
+// write, rewrite in place and truncate a file with its data
+// written around the log, then read it back; fsync and
+// O_SYNCCLOSE must succeed.
+void
+orderedwrite(char *s)
+{
+  int i, fd, old, nblocks = NDIRECT + 20;
+
+  old = datamode(DATA_ORDERED);
+  for(int pass = 0; pass < 2; pass++){
+    // the second pass truncates, so it reuses the blocks the
+    // first freed, in a transaction that freed them.
+    fd = open("ordered", O_CREATE|O_TRUNC|O_RDWR|O_SYNCCLOSE);
+    if(fd < 0){
+      printf("%s: create ordered failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < nblocks; i++){
+      memset(buf, pass*nblocks + i, BSIZE);
+      if(write(fd, buf, BSIZE) != BSIZE){
+        printf("%s: write ordered failed\n", s);
+        exit(1);
+      }
+    }
+    lseek(fd, BSIZE + 10, SEEK_SET);
+    memset(buf, 0xee, 100);
+    if(write(fd, buf, 100) != 100 || fsync(fd) != 0){
+      printf("%s: rewrite or fsync of ordered failed\n", s);
+      exit(1);
+    }
+    close(fd);
+  }
+  datamode(old);
+
+  fd = open("ordered", O_RDONLY);
+  for(i = 0; i < nblocks; i++){
+    if(read(fd, buf, BSIZE) != BSIZE){
+      printf("%s: read ordered failed\n", s);
+      exit(1);
+    }
+    for(int j = 0; j < BSIZE; j++){
+      char want = nblocks + i;
+      if(i == 1 && j >= 10 && j < 110)
+        want = 0xee;
+      if(buf[j] != want){
+        printf("%s: block %d byte %d is %d\n", s, i, j, buf[j]);
+        exit(1);
+      }
+    }
+  }
+  close(fd);
+  unlink("ordered");
+}
+
+// write past the end of a file: the gap must be a hole that
+// holds no blocks, reads as zeroes, and that SEEK_DATA and
+// SEEK_HOLE find.
+void
+sparsefile(char *s)
+{
+  int fd, off = (NDIRECT + 10) * BSIZE;
+  struct stat st;
+
+  fd = open("sparsef", O_CREATE|O_TRUNC|O_RDWR);
+  if(fd < 0){
+    printf("%s: create sparse failed\n", s);
+    exit(1);
+  }
+  memset(buf, 'a', BSIZE);
+  if(write(fd, buf, BSIZE) != BSIZE || lseek(fd, off, SEEK_SET) != off ||
+     write(fd, buf, BSIZE) != BSIZE){
+    printf("%s: write past the end failed\n", s);
+    exit(1);
+  }
+  // two data blocks and the indirect block.
+  if(fstat(fd, &st) < 0 || st.size != off + BSIZE || st.blocks != 3){
+    printf("%s: size %d blocks %d\n", s, (int)st.size, st.blocks);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_HOLE) != BSIZE || lseek(fd, BSIZE, SEEK_DATA) != off ||
+     lseek(fd, off, SEEK_HOLE) != off + BSIZE || lseek(fd, off + BSIZE, SEEK_DATA) != -1){
+    printf("%s: SEEK_HOLE or SEEK_DATA wrong\n", s);
+    exit(1);
+  }
+  lseek(fd, BSIZE, SEEK_SET);
+  for(int i = 1; i < off / BSIZE; i++){
+    if(read(fd, buf, BSIZE) != BSIZE){
+      printf("%s: read hole failed\n", s);
+      exit(1);
+    }
+    for(int j = 0; j < BSIZE; j++){
+      if(buf[j] != 0){
+        printf("%s: hole block %d is not zero\n", s, i);
+        exit(1);
+      }
+    }
+  }
+  close(fd);
+  unlink("sparsef");
+}
+
+// a tiny file lives in its inode, and moves to a block when
+// it grows; its data must survive the move.
+void
+inlinefile(char *s)
+{
+  int fd, n;
+  struct stat st;
+  char data[INLINESIZE + 20];
+
+  for(n = 0; n < sizeof(data); n++)
+    data[n] = 'a' + n % 26;
+  fd = open("inline", O_CREATE|O_TRUNC|O_RDWR);
+  if(fd < 0 || write(fd, data, 30) != 30 || fstat(fd, &st) < 0 ||
+     st.size != 30 || st.blocks != 0){
+    printf("%s: small file is not inline\n", s);
+    exit(1);
+  }
+  if(write(fd, data + 30, sizeof(data) - 30) != sizeof(data) - 30 ||
+     fstat(fd, &st) < 0 || st.size != sizeof(data) || st.blocks != 1){
+    printf("%s: grown file is not in a block\n", s);
+    exit(1);
+  }
+  close(fd);
+  fd = open("inline", O_RDONLY);
+  memset(buf, 0, sizeof(data));
+  if(read(fd, buf, sizeof(buf)) != sizeof(data) || memcmp(buf, data, sizeof(data)) != 0){
+    printf("%s: grown file lost its data\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("inline");
+}
+
+// big files whose blocks are freed in the background, by
+// unlink and by O_TRUNC: the truncated file must read as
+// empty and take new data.
+void
+bigunlink(char *s)
+{
+  int fd, i, round, nblocks = NDIRECT + 100;
+
+  for(round = 0; round < 4; round++){
+    fd = open("bigunlink", O_CREATE|O_TRUNC|O_RDWR);
+    if(fd < 0){
+      printf("%s: create bigunlink failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < nblocks; i++){
+      memset(buf, round, BSIZE);
+      if(write(fd, buf, BSIZE) != BSIZE){
+        printf("%s: write bigunlink failed\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+    if(round % 2 == 0){
+      unlink("bigunlink");
+      continue;
+    }
+    fd = open("bigunlink", O_TRUNC|O_RDWR);
+    if(fd < 0 || read(fd, buf, BSIZE) != 0){
+      printf("%s: truncated file is not empty\n", s);
+      exit(1);
+    }
+    memset(buf, 'z', BSIZE);
+    if(write(fd, buf, BSIZE) != BSIZE || lseek(fd, 0, SEEK_SET) != 0 ||
+       read(fd, buf, BSIZE) != BSIZE || buf[0] != 'z'){
+      printf("%s: write after truncate failed\n", s);
+      exit(1);
+    }
+    close(fd);
+    unlink("bigunlink");
+  }
+}
+
+// read block bn of name and check that it is all c.
+static void
+checkblock(char *s, char *name, int bn, int c)
+{
+  int fd, i;
+
+  fd = open(name, O_RDONLY);
+  if(fd < 0 || lseek(fd, bn * BSIZE, SEEK_SET) != bn * BSIZE ||
+     read(fd, buf, BSIZE) != BSIZE){
+    printf("%s: read %s block %d failed\n", s, name, bn);
+    exit(1);
+  }
+  for(i = 0; i < BSIZE; i++){
+    if(buf[i] != (char)c){
+      printf("%s: %s block %d has %d, not %d\n", s, name, bn, buf[i], c);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// a clone shares its source's blocks: a write to either must
+// not show in the other, and the clone must outlive the source.
+void
+clonefile(char *s)
+{
+  int fd, i, nblocks = NDIRECT + 4;
+
+  fd = open("clonef", O_CREATE|O_TRUNC|O_WRONLY);
+  for(i = 0; i < nblocks; i++){
+    memset(buf, i, BSIZE);
+    if(fd < 0 || write(fd, buf, BSIZE) != BSIZE){
+      printf("%s: write clonef failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("clonef2");
+  if(clone("clonef", "clonef2") < 0){
+    printf("%s: clone failed\n", s);
+    exit(1);
+  }
+
+  memset(buf, 'c', BSIZE);
+  fd = open("clonef2", O_WRONLY);
+  if(fd < 0 || write(fd, buf, BSIZE) != BSIZE){
+    printf("%s: write clonef2 failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  memset(buf, 's', BSIZE);
+  fd = open("clonef", O_WRONLY);
+  if(fd < 0 || lseek(fd, (NDIRECT + 1) * BSIZE, SEEK_SET) < 0 ||
+     write(fd, buf, BSIZE) != BSIZE){
+    printf("%s: write clonef failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  checkblock(s, "clonef", 0, 0);
+  checkblock(s, "clonef2", 0, 'c');
+  checkblock(s, "clonef", NDIRECT + 1, 's');
+  checkblock(s, "clonef2", NDIRECT + 1, NDIRECT + 1);
+
+  unlink("clonef");
+  for(i = 1; i < nblocks; i++)
+    checkblock(s, "clonef2", i, i);
+  unlink("clonef2");
+}
+
+// a compressed file must read back what was written, in
+// writes that straddle clusters, over holes, and in place, and
+// take fewer blocks than the data.
+void
+compressfile(char *s)
+{
+  int fd, i, n, size = 3 * CLUSTERSIZE + 100;
+  struct stat st;
+  char c;
+
+  fd = open("compressf", O_CREATE|O_TRUNC|O_RDWR|O_COMPRESS);
+  if(fd < 0){
+    printf("%s: create compressf failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < size; i += n){
+    n = size - i < 1000 ? size - i : 1000;
+    for(int j = 0; j < n; j++)
+      buf[j] = 'a' + (i + j) / 7 % 26;
+    if(write(fd, buf, n) != n){
+      printf("%s: write compressf failed\n", s);
+      exit(1);
+    }
+  }
+  if(fstat(fd, &st) < 0 || st.size != size || st.blocks >= size / BSIZE){
+    printf("%s: compressf is not compressed\n", s);
+    exit(1);
+  }
+
+  // overwrite in place, then write past a hole cluster.
+  if(lseek(fd, CLUSTERSIZE - 2, SEEK_SET) != CLUSTERSIZE - 2 || write(fd, "XYZ", 3) != 3 ||
+     lseek(fd, 5 * CLUSTERSIZE, SEEK_SET) != 5 * CLUSTERSIZE || write(fd, "end", 3) != 3){
+    printf("%s: rewrite compressf failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("compressf", O_RDONLY);
+  for(i = 0; i < 5 * CLUSTERSIZE + 3; i++){
+    if(read(fd, &c, 1) != 1){
+      printf("%s: read compressf failed at %d\n", s, i);
+      exit(1);
+    }
+    if(i >= CLUSTERSIZE - 2 && i < CLUSTERSIZE + 1)
+      n = "XYZ"[i - (CLUSTERSIZE - 2)];
+    else if(i < size)
+      n = 'a' + i / 7 % 26;
+    else if(i >= 5 * CLUSTERSIZE)
+      n = "end"[i - 5 * CLUSTERSIZE];
+    else
+      n = 0;
+    if(c != n){
+      printf("%s: compressf has %d at %d, not %d\n", s, c, i, n);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("compressf");
+}
+
 // many creates, followed by unlink test
 void
 createtest(char *s)
@@ -2165,6 +2476,51 @@ MAXVAplus(char *s)
   }
 }
 
+// system calls given a PROT_NONE buffer must fail, not map
+// it afresh or panic, and MADV_DONTNEED must not drop its
+// protection.
+void
+protnone(char *s)
+{
+  char *a;
+  int fd;
+
+  a = sbrk(2*PGSIZE);
+  if(a == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  a = (char*)PGROUNDUP((uint64)a);
+  a[0] = 'x';
+  if(mprotect(a, PGSIZE, PROT_NONE) < 0){
+    printf("%s: mprotect failed\n", s);
+    exit(1);
+  }
+  if(madvise(a, PGSIZE, MADV_DONTNEED) != -1){
+    printf("%s: MADV_DONTNEED dropped a PROT_NONE page\n", s);
+    exit(1);
+  }
+  fd = open("protnone", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create protnone failed\n", s);
+    exit(1);
+  }
+  if(write(fd, a, 1) != -1){
+    printf("%s: write from a PROT_NONE page succeeded\n", s);
+    exit(1);
+  }
+  if(write(fd, "y", 1) != 1 || lseek(fd, 0, SEEK_SET) != 0 || read(fd, a, 1) != -1){
+    printf("%s: read into a PROT_NONE page succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("protnone");
+  if(mprotect(a, PGSIZE, PROT_READ|PROT_WRITE) < 0 || a[0] != 'x'){
+    printf("%s: page lost its data\n", s);
+    exit(1);
+  }
+}
+
 // if we run the system out of memory, does it clean up the last
 // failed allocation?
 void
@@ -2421,6 +2777,36 @@ stacktest(char *s)
     exit(xstatus);
 }
 
+// recurse with big frames; each level checks that its
+// frame survived the levels below it.
+int
+stackrecurse(int depth)
+{
+  volatile char frame[4000];
+  int sum;
+
+  frame[0] = depth;
+  frame[sizeof(frame)-1] = depth;
+  if(depth == 0)
+    return 0;
+  sum = stackrecurse(depth - 1);
+  if(frame[0] != (char)depth || frame[sizeof(frame)-1] != (char)depth)
+    return -1;
+  return sum < 0 ? -1 : sum + 1;
+}
+
+// check that the stack grows on demand well past its first page.
+void
+stackgrow(char *s)
+{
+  int depth = 1000;  // about 4 MiB
+
+  if(stackrecurse(depth) != depth){
+    printf("%s: deep stack corrupted\n", s);
+    exit(1);
+  }
+}
+
 // check that writes to text segment fault
 void
 textwrite(char *s)
@@ -2571,14 +2957,17 @@ badarg(char *s)
   exit(0);
 }
 
+#define ALONE 1  // must not run concurrently with other tests
+
 struct test {
   void (*f)(char *);
   char *s;
+  int alone;
 } quicktests[] = {
   {copyin, "copyin"},
   {copyout, "copyout"},
   {copyinstr1, "copyinstr1"},
-  {copyinstr2, "copyinstr2"},
+  {copyinstr2, "copyinstr2", ALONE},
   {copyinstr3, "copyinstr3"},
   {rwsbrk, "rwsbrk" },
   {truncate1, "truncate1"},
@@ -2586,23 +2975,29 @@ struct test {
   {truncate3, "truncate3"},
   {openiputtest, "openiput"},
   {exitiputtest, "exitiput"},
-  {iputtest, "iput"},
-  {opentest, "opentest"},
+  {iputtest, "iput", ALONE},
+  {opentest, "opentest", ALONE},
   {writetest, "writetest"},
   {writebig, "writebig"},
+  {orderedwrite, "orderedwrite", ALONE},
+  {sparsefile, "sparsefile"},
+  {bigunlink, "bigunlink"},
+  {inlinefile, "inlinefile"},
+  {clonefile, "clonefile"},
+  {compressfile, "compressfile"},
   {createtest, "createtest"},
-  {dirtest, "dirtest"},
-  {exectest, "exectest"},
+  {dirtest, "dirtest", ALONE},
+  {exectest, "exectest", ALONE},
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
   {exitwait, "exitwait"},
   {reparent, "reparent" },
   {twochildren, "twochildren"},
-  {forkfork, "forkfork"},
-  {forkforkfork, "forkforkfork"},
-  {reparent2, "reparent2"},
-  {mem, "mem"},
+  {forkfork, "forkfork", ALONE},
+  {forkforkfork, "forkforkfork", ALONE},
+  {reparent2, "reparent2", ALONE},
+  {mem, "mem", ALONE},
   {sharedfd, "sharedfd"},
   {fourfiles, "fourfiles"},
   {createdelete, "createdelete"},
@@ -2610,31 +3005,33 @@ struct test {
   {linktest, "linktest"},
   {concreate, "concreate"},
   {linkunlink, "linkunlink"},
-  {subdir, "subdir"},
+  {subdir, "subdir", ALONE},
   {bigwrite, "bigwrite"},
   {bigfile, "bigfile"},
   {fourteen, "fourteen"},
-  {rmdot, "rmdot"},
+  {rmdot, "rmdot", ALONE},
   {dirfile, "dirfile"},
-  {iref, "iref"},
-  {forktest, "forktest"},
+  {iref, "iref", ALONE},
+  {forktest, "forktest", ALONE},
   {sbrkbasic, "sbrkbasic"},
-  {sbrkmuch, "sbrkmuch"},
+  {sbrkmuch, "sbrkmuch", ALONE},
   {kernmem, "kernmem"},
   {MAXVAplus, "MAXVAplus"},
-  {sbrkfail, "sbrkfail"},
+  {sbrkfail, "sbrkfail", ALONE},
+  {protnone, "protnone"},
   {sbrkarg, "sbrkarg"},
   {validatetest, "validatetest"},
   {bsstest, "bsstest"},
-  {bigargtest, "bigargtest"},
-  {argptest, "argptest"},
+  {bigargtest, "bigargtest", ALONE},
+  {argptest, "argptest", ALONE},
   {stacktest, "stacktest"},
+  {stackgrow, "stackgrow"},
   {textwrite, "textwrite"},
   {pgbug, "pgbug" },
   {sbrkbugs, "sbrkbugs" },
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
-  {badarg, "badarg" },
+  {badarg, "badarg", ALONE},
 
   { 0, 0},
 };
@@ -2925,12 +3322,12 @@ outofinodes(char *s)
 }
 
 struct test slowtests[] = {
-  {bigdir, "bigdir"},
-  {manywrites, "manywrites"},
-  {badwrite, "badwrite" },
-  {execout, "execout"},
-  {diskfull, "diskfull"},
-  {outofinodes, "outofinodes"},
+  {bigdir, "bigdir", ALONE},
+  {manywrites, "manywrites", ALONE},
+  {badwrite, "badwrite", ALONE},
+  {execout, "execout", ALONE},
+  {diskfull, "diskfull", ALONE},
+  {outofinodes, "outofinodes", ALONE},
     
   { 0, 0},
 };
@@ -3074,26 +3471,188 @@ drivetests(int quick, int continuous, char *justone) {
   return 0;
 }
 
+//
+// parallel driver: usertests -p
+//
+
+#define MAXTESTS 100
+
+struct result {
+  struct test *t;
+  int pid;          // while running
+  int start;        // uptime() when started
+  int total;        // elapsed ticks, summed over runs
+  int min, max;
+  int failed;       // runs that failed
+};
+
+// the private directory of the i'th test.
+void
+testdir(int i, char *dir)
+{
+  strcpy(dir, "ut00");
+  dir[2] = '0' + i / 10;
+  dir[3] = '0' + i % 10;
+}
+
+// run each of res[0..n-1]'s tests once, njobs at a time, and
+// record their elapsed ticks. a test marked ALONE waits for
+// the running tests to finish, then runs by itself in the
+// current directory; the others each run in a directory of
+// their own, so that their file names can't collide.
+// returns the number of failures.
+int
+runparallel(struct result *res, int n, int njobs)
+{
+  int next = 0, running = 0, alone = 0, failures = 0;
+  int i, pid, xstatus, ticks;
+  char dir[8];
+
+  while(next < n || running > 0){
+    while(next < n && running < njobs && !alone &&
+          !(res[next].t->alone && running > 0)){
+      i = next++;
+      testdir(i, dir);
+      if(!res[i].t->alone)
+        mkdir(dir);
+      res[i].start = uptime();
+      if((pid = fork()) < 0){
+        printf("usertests: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        if(!res[i].t->alone && chdir(dir) < 0){
+          printf("usertests: cannot chdir %s\n", dir);
+          exit(1);
+        }
+        res[i].t->f(res[i].t->s);
+        exit(0);
+      }
+      res[i].pid = pid;
+      alone = res[i].t->alone;
+      running++;
+    }
+
+    if((pid = wait(&xstatus)) < 0)
+      break;
+    for(i = 0; i < next; i++)
+      if(res[i].pid == pid)
+        break;
+    if(i == next)
+      continue;
+    ticks = uptime() - res[i].start;
+    res[i].pid = 0;
+    running--;
+    if(res[i].t->alone)
+      alone = 0;
+    else {
+      testdir(i, dir);
+      unlink(dir);
+    }
+
+    res[i].total += ticks;
+    if(ticks < res[i].min)
+      res[i].min = ticks;
+    if(ticks > res[i].max)
+      res[i].max = ticks;
+    if(xstatus != 0){
+      res[i].failed++;
+      failures++;
+    }
+    printf("test %s: %s (%d ticks)\n", res[i].t->s,
+           xstatus == 0 ? "OK" : "FAILED", ticks);
+  }
+  return failures;
+}
+
+// run the tests nruns times in parallel, then print each
+// test's elapsed ticks, slowest first. min and max over the
+// runs show how noisy a test's time is.
+int
+driveparallel(int quick, char *justone, int njobs, int nruns)
+{
+  static struct result res[MAXTESTS];
+  struct result tmp;
+  struct test *t;
+  int n = 0, failures = 0, i, j, start, free0, free1;
+
+  for(t = quicktests; t->s != 0 && n < MAXTESTS; t++)
+    if(justone == 0 || strcmp(t->s, justone) == 0)
+      res[n++].t = t;
+  for(t = slowtests; !quick && t->s != 0 && n < MAXTESTS; t++)
+    if(justone == 0 || strcmp(t->s, justone) == 0)
+      res[n++].t = t;
+
+  for(i = 0; i < n; i++)
+    res[i].min = 1 << 30;
+
+  free0 = countfree();
+  for(i = 0; i < nruns; i++){
+    printf("usertests: run %d, %d jobs\n", i + 1, njobs);
+    start = uptime();
+    failures += runparallel(res, n, njobs);
+    printf("usertests: run %d took %d ticks\n", i + 1, uptime() - start);
+  }
+  free1 = countfree();
+
+  // sort by mean time, slowest first.
+  for(i = 1; i < n; i++){
+    for(j = i; j > 0 && res[j].total > res[j-1].total; j--){
+      tmp = res[j];
+      res[j] = res[j-1];
+      res[j-1] = tmp;
+    }
+  }
+  printf("test\tmean\tmin\tmax\tfailed\n");
+  for(i = 0; i < n; i++)
+    printf("%s\t%d\t%d\t%d\t%d\n", res[i].t->s, res[i].total / nruns,
+           res[i].min, res[i].max, res[i].failed);
+
+  if(free1 < free0){
+    printf("FAILED -- lost some free pages %d (out of %d)\n", free1, free0);
+    return 1;
+  }
+  if(failures){
+    printf("SOME TESTS FAILED\n");
+    return 1;
+  }
+  return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
   int continuous = 0;
   int quick = 0;
+  int parallel = 0;
+  int njobs = 4;
+  int nruns = 1;
   char *justone = 0;
 
-  if(argc == 2 && strcmp(argv[1], "-q") == 0){
-    quick = 1;
-  } else if(argc == 2 && strcmp(argv[1], "-c") == 0){
-    continuous = 1;
-  } else if(argc == 2 && strcmp(argv[1], "-C") == 0){
-    continuous = 2;
-  } else if(argc == 2 && argv[1][0] != '-'){
-    justone = argv[1];
-  } else if(argc > 1){
-    printf("Usage: usertests [-c] [-C] [-q] [testname]\n");
-    exit(1);
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-q") == 0){
+      quick = 1;
+    } else if(strcmp(argv[i], "-c") == 0){
+      continuous = 1;
+    } else if(strcmp(argv[i], "-C") == 0){
+      continuous = 2;
+    } else if(strcmp(argv[i], "-p") == 0){
+      parallel = 1;
+    } else if(argv[i][0] == '-' && argv[i][1] == 'j' && atoi(argv[i]+2) > 0){
+      njobs = atoi(argv[i]+2);
+    } else if(argv[i][0] == '-' && argv[i][1] == 'n' && atoi(argv[i]+2) > 0){
+      nruns = atoi(argv[i]+2);
+    } else if(argv[i][0] != '-' && justone == 0){
+      justone = argv[i];
+    } else {
+      printf("Usage: usertests [-c] [-C] [-q] [-p [-jN] [-nN]] [testname]\n");
+      exit(1);
+    }
   }
-  if (drivetests(quick, continuous, justone)) {
+  if(parallel){
+    if(driveparallel(quick, justone, njobs, nruns))
+      exit(1);
+  } else if (drivetests(quick, continuous, justone)) {
     exit(1);
   }
   printf("ALL TESTS PASSED\n");
@@ -36,3 +36,22 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("lseek");
+entry("mount");
+entry("irqaffinity");
+entry("irqstat");
+entry("lockbench");
+entry("kstat");
+entry("rcubench");
+entry("meminfo");
+entry("madvise");
+entry("mprotect");
+entry("sigsegv");
+entry("sigreturn");
+entry("procmem");
+entry("uptimeus");
+entry("trace");
+entry("tracedump");
+entry("fsync");
+entry("datamode");
+entry("clone");
@@ -0,0 +1,56 @@
+//
+// vmstat [interval [count]]: every interval seconds (default 1),
+// print per-second rates of page allocations and frees, lazy and
+// copy-on-write page faults, and steals between cpus' free page
+// caches, plus the free page count. stops after count lines if
+// count is given.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+#define TICKS_PER_SEC 10  // timer interrupts are about 1/10th second apart
+
+static int
+rate(uint64 now, uint64 then, int ticks)
+{
+  return (int)((now - then) * TICKS_PER_SEC / ticks);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct kstat k0, k1;
+  struct meminfo mi;
+  int interval, count, i, t0, t1;
+
+  interval = argc > 1 ? atoi(argv[1]) : 1;
+  count = argc > 2 ? atoi(argv[2]) : -1;
+  if(interval < 1){
+    printf("usage: vmstat [interval [count]]\n");
+    exit(1);
+  }
+
+  printf("free\tkalloc/s\tkfree/s\tlazy/s\tcow/s\tsteal/s\n");
+  kstat(&k0);
+  t0 = uptime();
+  for(i = 0; count < 0 || i < count; i++){
+    sleep(interval * TICKS_PER_SEC);
+    kstat(&k1);
+    t1 = uptime();
+    meminfo(&mi);
+    if(t1 == t0)
+      t1 = t0 + 1;
+    printf("%d\t%d\t\t%d\t%d\t%d\t%d\n", (int)mi.free,
+           rate(k1.nkalloc, k0.nkalloc, t1 - t0),
+           rate(k1.nkfree, k0.nkfree, t1 - t0),
+           rate(k1.nlazyfault, k0.nlazyfault, t1 - t0),
+           rate(k1.ncowfault, k0.ncowfault, t1 - t0),
+           rate(k1.nsteal, k0.nsteal, t1 - t0));
+    k0 = k1;
+    t0 = t1;
+  }
+  exit(0);
+}